@@ -284,6 +284,10 @@ pref("browser.urlbar.clickSelectsAll", true);
 pref("browser.urlbar.doubleClickSelectsAll", false);
 pref("browser.urlbar.autoFill", true);
 pref("browser.urlbar.autoFill.typed", true);
+// Complete the URL bar synchronously from an in-memory trie of the hosts and
+// URL directories with the highest frecency, before the autofill search ends.
+pref("browser.urlbar.autoFill.instant", true);
+pref("browser.urlbar.autoFill.instant.maxEntries", 2000);
 // 0: Match anywhere (e.g., middle of words)
 // 1: Match on word boundaries and then try matching anywhere
 // 2: Match only on word boundaries (e.g., after / or .)
@@ -340,6 +344,16 @@ pref("browser.altClickSave", true);
 // Enable logging downloads operations to the Error Console.
 pref("browser.download.debug", false);
 
+// Minimum number of milliseconds between two progress updates of the same
+// download in the downloads panel, indicator and Library (16 = once a frame).
+pref("browser.download.progressInterval", 16);
+
+// Maximum number of parallel range requests used to download a file from a
+// server that supports them (1 uses a single request), and minimum size in
+// bytes of the parts a file is split into.
+pref("browser.download.segmentedConnections", 1);
+pref("browser.download.segmentedMinSize", 1048576);
+
 // Number of milliseconds to wait for the http headers (and thus
 // the Content-Disposition filename) before giving up and falling back to 
 // picking a filename without that info in hand so that the user sees some
@@ -479,6 +493,12 @@ pref("browser.tabs.showAudioPlayingIcon", true);
 // This should match Chromium's audio indicator delay.
 pref("browser.tabs.delayHidingAudioPlayingIconMS", 3000);
 
+// Unload the least recently selected tab when memory is low, and unload tabs
+// when more than maxLoadedTabs are loaded in a window (0 means no limit).
+// Pinned tabs, tabs playing audio and tabs with form data are kept loaded.
+pref("browser.tabs.unload.onLowMemory", true);
+pref("browser.tabs.unload.maxLoadedTabs", 0);
+
 // Whether dragging a tab off the tab bar to tear it off into its own
 // window is enabled.
 pref("browser.tabs.allowTabDetach", true);
@@ -838,6 +858,12 @@ pref("browser.sessionstore.resume_session_once", false);
 
 // minimal interval between two save operations in milliseconds
 pref("browser.sessionstore.interval",60000);
+// size in bytes up to which changes are appended to sessionstore.journal instead
+// of rewriting the whole session file on every save (0 = always rewrite)
+pref("browser.sessionstore.max_journal_size", 1048576);
+// write the session file LZ4 compressed; both compressed and uncompressed
+// session files are read regardless of this pref
+pref("browser.sessionstore.compression", false);
 // maximum amount of POSTDATA to be saved in bytes per history entry (-1 = all of it)
 // (NB: POSTDATA will be saved either entirely or not at all)
 pref("browser.sessionstore.postdata", 0);
@@ -851,6 +877,10 @@ pref("browser.sessionstore.max_tabs_undo", 10);
 // how many windows can be reopened (per session) - on non-OS X platforms this
 // pref may be ignored when dealing with pop-up windows to ensure proper startup
 pref("browser.sessionstore.max_windows_undo", 3);
+// how many of the most recently closed tabs (per window) and windows are kept
+// in memory in full; older ones are stored in the sessionstore-closed directory
+// of the profile until they are reopened (-1 = keep all of them in memory)
+pref("browser.sessionstore.max_closed_in_memory", 3);
 // number of crashes that can occur before the about:sessionrestore page is displayed
 // (this pref has no effect if more than 6 hours have passed since the last crash)
 pref("browser.sessionstore.max_resumed_crashes", 1);
@@ -864,9 +894,11 @@ pref("browser.sessionstore.max_serialize_forward", -1);
 // for browser.sessionstore.max_concurrent_tabs and restore_hidden_tabs are 
 // respected. Selected tabs are always restored regardless of this pref.
 pref("browser.sessionstore.restore_on_demand", true);
-// The number of tabs that can restore concurrently.
-// Sane values are 1..10, default 3.
-pref("browser.sessionstore.max_concurrent_tabs", 3);
+// The maximum number of tabs that can restore concurrently. Restoring starts
+// with 3 tabs at a time, and adapts between 1 and this number depending on how
+// busy the network and the main thread are.
+// Sane values are 1..10, default 6.
+pref("browser.sessionstore.max_concurrent_tabs", 6);
 // Whether to automatically restore hidden tabs (i.e., tabs in other tab groups) or not
 pref("browser.sessionstore.restore_hidden_tabs", false);
 // If restore_on_demand is set, pinned tabs are restored on startup by default.
@@ -889,6 +921,14 @@ pref("accessibility.blockautorefresh", false);
 // Whether history is enabled or not.
 pref("places.history.enabled", true);
 
+// Whether to keep the titles and URLs of recently visited pages in an
+// in-memory index, to search history in the sidebar and the Library without
+// querying the database.
+pref("places.history.searchIndex.enabled", true);
+// The maximum number of pages in the index. Older pages are searched in the
+// database.
+pref("places.history.searchIndex.maxEntries", 5000);
+
 // the (maximum) number of the recent visits to sample
 // when calculating frecency
 pref("places.frecency.numVisits", 10);
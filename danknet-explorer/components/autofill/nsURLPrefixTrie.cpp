@@ -0,0 +1,497 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "nsURLPrefixTrie.h"
+
+#include "nsCOMPtr.h"
+#include "nsIFile.h"
+#include "prio.h"
+
+#include <string.h>
+
+// Snapshots start with this magic and the number of entries, followed by
+// each entry's frecency, length and text.  They are only ever read on the
+// machine that wrote them, so numbers are in native byte order.
+static const char kSnapshotMagic[] = "URLTRIE1";
+static const uint32_t kMagicLength = sizeof(kSnapshotMagic) - 1;
+static const uint32_t kHeaderLength = kMagicLength + sizeof(uint32_t);
+static const int64_t kMaxSnapshotSize = 16 * 1024 * 1024;
+
+static const uint32_t kDefaultMaxEntries = 2000;
+
+// Nodes of removed entries are reclaimed once there are more of them than
+// live entries, and at least this many.
+static const uint32_t kMinRemovedBeforeRebuild = 64;
+
+static void
+GetKey(const nsACString& aText, nsACString& aKey)
+{
+  aKey.Assign(aText);
+  ToLowerCase(aKey);
+}
+
+NS_IMPL_ISUPPORTS(nsURLPrefixTrie, nsIURLPrefixTrie)
+
+nsURLPrefixTrie::nsURLPrefixTrie()
+  : mCount(0)
+  , mMaxEntries(kDefaultMaxEntries)
+  , mRemovedCount(0)
+{
+  Clear();
+}
+
+NS_IMETHODIMP
+nsURLPrefixTrie::GetMaxEntries(uint32_t* aMaxEntries)
+{
+  *aMaxEntries = mMaxEntries;
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+nsURLPrefixTrie::SetMaxEntries(uint32_t aMaxEntries)
+{
+  mMaxEntries = aMaxEntries;
+  while (mCount > mMaxEntries) {
+    RemoveEntry(FindWorstEntry());
+  }
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+nsURLPrefixTrie::GetCount(uint32_t* aCount)
+{
+  *aCount = mCount;
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+nsURLPrefixTrie::Add(const nsACString& aText, double aFrecency,
+                     bool aKeepHigher)
+{
+  if (aText.IsEmpty()) {
+    return NS_ERROR_INVALID_ARG;
+  }
+
+  nsAutoCString key;
+  GetKey(aText, key);
+
+  int32_t node = FindNode(key, false);
+  int32_t entry = node >= 0 ? mNodes[node].mEntry : -1;
+  if (entry >= 0) {
+    if (aKeepHigher && mEntries[entry].mFrecency >= aFrecency) {
+      return NS_OK;
+    }
+    mEntries[entry].mText.Assign(aText);
+    mEntries[entry].mFrecency = aFrecency;
+    HeapUpdate(entry);
+    UpdateBest(key);
+    return NS_OK;
+  }
+
+  if (mCount >= mMaxEntries) {
+    int32_t worst = FindWorstEntry();
+    if (worst < 0 || mEntries[worst].mFrecency >= aFrecency) {
+      return NS_OK;
+    }
+    // This may rebuild the nodes, so only look the new one up afterwards.
+    RemoveEntry(worst);
+  }
+
+  node = FindNode(key, true);
+  if (mFreeEntries.IsEmpty()) {
+    entry = mEntries.Length();
+    mEntries.AppendElement();
+  } else {
+    entry = mFreeEntries[mFreeEntries.Length() - 1];
+    mFreeEntries.RemoveElementAt(mFreeEntries.Length() - 1);
+  }
+  mEntries[entry].mText.Assign(aText);
+  mEntries[entry].mFrecency = aFrecency;
+  mEntries[entry].mNode = node;
+  mNodes[node].mEntry = entry;
+  mCount++;
+  HeapInsert(entry);
+
+  UpdateBest(key);
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+nsURLPrefixTrie::Remove(const nsACString& aText)
+{
+  nsAutoCString key;
+  GetKey(aText, key);
+
+  int32_t node = FindNode(key, false);
+  if (node >= 0 && mNodes[node].mEntry >= 0) {
+    RemoveEntry(mNodes[node].mEntry);
+  }
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+nsURLPrefixTrie::Clear()
+{
+  mNodes.Clear();
+  Node* root = mNodes.AppendElement();
+  root->mFirstChild = 0;
+  root->mNextSibling = 0;
+  root->mEntry = -1;
+  root->mBest = -1;
+  root->mChar = '\0';
+
+  mEntries.Clear();
+  mFreeEntries.Clear();
+  mHeap.Clear();
+  mCount = 0;
+  mRemovedCount = 0;
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+nsURLPrefixTrie::Complete(const nsACString& aPrefix, nsACString& aResult)
+{
+  aResult.Truncate();
+  if (aPrefix.IsEmpty()) {
+    return NS_OK;
+  }
+
+  nsAutoCString key;
+  GetKey(aPrefix, key);
+
+  int32_t node = FindNode(key, false);
+  if (node >= 0 && mNodes[node].mBest >= 0) {
+    aResult.Assign(mEntries[mNodes[node].mBest].mText);
+  }
+  return NS_OK;
+}
+
+NS_IMETHODIMP
+nsURLPrefixTrie::LoadSnapshot(nsIFile* aFile)
+{
+  NS_ENSURE_ARG(aFile);
+
+  int64_t size;
+  nsresult rv = aFile->GetFileSize(&size);
+  NS_ENSURE_SUCCESS(rv, rv);
+  if (size < kHeaderLength || size > kMaxSnapshotSize) {
+    return NS_ERROR_FILE_CORRUPTED;
+  }
+
+  PRFileDesc* fd;
+  rv = aFile->OpenNSPRFileDesc(PR_RDONLY, 0, &fd);
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  PRFileMap* map = PR_CreateFileMap(fd, size, PR_PROT_READONLY);
+  if (!map) {
+    PR_Close(fd);
+    return NS_ERROR_FAILURE;
+  }
+
+  void* data = PR_MemMap(map, 0, uint32_t(size));
+  if (!data) {
+    PR_CloseFileMap(map);
+    PR_Close(fd);
+    return NS_ERROR_FAILURE;
+  }
+
+  rv = ParseSnapshot(static_cast<const char*>(data), uint32_t(size));
+
+  PR_MemUnmap(data, uint32_t(size));
+  PR_CloseFileMap(map);
+  PR_Close(fd);
+  return rv;
+}
+
+NS_IMETHODIMP
+nsURLPrefixTrie::WriteSnapshot(nsIFile* aFile)
+{
+  NS_ENSURE_ARG(aFile);
+
+  nsCString data;
+  data.Append(kSnapshotMagic, kMagicLength);
+  data.Append(reinterpret_cast<const char*>(&mCount), sizeof(mCount));
+  for (uint32_t i = 0; i < mEntries.Length(); ++i) {
+    const Entry& entry = mEntries[i];
+    if (entry.mText.IsEmpty()) {
+      continue;
+    }
+    uint32_t length = entry.mText.Length();
+    data.Append(reinterpret_cast<const char*>(&entry.mFrecency),
+                sizeof(entry.mFrecency));
+    data.Append(reinterpret_cast<const char*>(&length), sizeof(length));
+    data.Append(entry.mText);
+  }
+
+  // Write to a temporary file first, so that a snapshot is never left half
+  // written.
+  nsAutoCString leafName;
+  nsresult rv = aFile->GetNativeLeafName(leafName);
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  nsCOMPtr<nsIFile> parent;
+  rv = aFile->GetParent(getter_AddRefs(parent));
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  nsCOMPtr<nsIFile> tempFile;
+  rv = aFile->Clone(getter_AddRefs(tempFile));
+  NS_ENSURE_SUCCESS(rv, rv);
+  nsAutoCString tempName(leafName);
+  tempName.Append(".tmp");
+  rv = tempFile->SetNativeLeafName(tempName);
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  PRFileDesc* fd;
+  rv = tempFile->OpenNSPRFileDesc(PR_WRONLY | PR_CREATE_FILE | PR_TRUNCATE,
+                                  0600, &fd);
+  NS_ENSURE_SUCCESS(rv, rv);
+
+  int32_t written = PR_Write(fd, data.get(), data.Length());
+  PR_Close(fd);
+  if (written != int32_t(data.Length())) {
+    tempFile->Remove(false);
+    return NS_ERROR_FAILURE;
+  }
+
+  return tempFile->MoveToNative(parent, leafName);
+}
+
+int32_t
+nsURLPrefixTrie::FindNode(const nsACString& aKey, bool aCreate)
+{
+  const char* chars = aKey.BeginReading();
+  uint32_t node = 0;
+  for (uint32_t i = 0; i < aKey.Length(); ++i) {
+    uint32_t child = mNodes[node].mFirstChild;
+    while (child && mNodes[child].mChar != chars[i]) {
+      child = mNodes[child].mNextSibling;
+    }
+
+    if (!child) {
+      if (!aCreate) {
+        return -1;
+      }
+      child = mNodes.Length();
+      Node* newNode = mNodes.AppendElement();
+      newNode->mFirstChild = 0;
+      newNode->mNextSibling = mNodes[node].mFirstChild;
+      newNode->mEntry = -1;
+      newNode->mBest = -1;
+      newNode->mChar = chars[i];
+      mNodes[node].mFirstChild = child;
+    }
+    node = child;
+  }
+  return node;
+}
+
+// Recompute the best entry of the nodes on the path of aKey, from its end
+// up to the root.
+void
+nsURLPrefixTrie::UpdateBest(const nsACString& aKey)
+{
+  AutoTArray<uint32_t, 64> path;
+  const char* chars = aKey.BeginReading();
+  uint32_t node = 0;
+  path.AppendElement(node);
+  for (uint32_t i = 0; i < aKey.Length(); ++i) {
+    node = mNodes[node].mFirstChild;
+    while (node && mNodes[node].mChar != chars[i]) {
+      node = mNodes[node].mNextSibling;
+    }
+    if (!node) {
+      break;
+    }
+    path.AppendElement(node);
+  }
+
+  for (uint32_t i = path.Length(); i > 0; --i) {
+    Node& current = mNodes[path[i - 1]];
+    int32_t best = current.mEntry;
+    for (uint32_t child = current.mFirstChild; child;
+         child = mNodes[child].mNextSibling) {
+      if (IsBetter(mNodes[child].mBest, best)) {
+        best = mNodes[child].mBest;
+      }
+    }
+    current.mBest = best;
+  }
+}
+
+bool
+nsURLPrefixTrie::IsBetter(int32_t aEntry, int32_t aOther) const
+{
+  if (aEntry < 0) {
+    return false;
+  }
+  if (aOther < 0) {
+    return true;
+  }
+  const Entry& entry = mEntries[aEntry];
+  const Entry& other = mEntries[aOther];
+  if (entry.mFrecency != other.mFrecency) {
+    return entry.mFrecency > other.mFrecency;
+  }
+  return entry.mText.Length() < other.mText.Length();
+}
+
+void
+nsURLPrefixTrie::RemoveEntry(int32_t aEntry)
+{
+  HeapRemove(aEntry);
+
+  Entry& entry = mEntries[aEntry];
+  nsAutoCString key;
+  GetKey(entry.mText, key);
+
+  mNodes[entry.mNode].mEntry = -1;
+  entry.mText.Truncate();
+  mFreeEntries.AppendElement(aEntry);
+  mCount--;
+  mRemovedCount++;
+
+  if (mRemovedCount >= kMinRemovedBeforeRebuild && mRemovedCount > mCount) {
+    Rebuild();
+  } else {
+    UpdateBest(key);
+  }
+}
+
+int32_t
+nsURLPrefixTrie::FindWorstEntry() const
+{
+  return mHeap.IsEmpty() ? -1 : mHeap[0];
+}
+
+void
+nsURLPrefixTrie::HeapInsert(int32_t aEntry)
+{
+  mEntries[aEntry].mHeapIndex = mHeap.Length();
+  mHeap.AppendElement(aEntry);
+  SiftUp(mHeap.Length() - 1);
+}
+
+void
+nsURLPrefixTrie::HeapRemove(int32_t aEntry)
+{
+  uint32_t index = mEntries[aEntry].mHeapIndex;
+  int32_t last = mHeap[mHeap.Length() - 1];
+  mHeap.RemoveElementAt(mHeap.Length() - 1);
+  if (last != aEntry) {
+    HeapSet(index, last);
+    HeapUpdate(last);
+  }
+}
+
+// Move the entry to its place after its rank changed.
+void
+nsURLPrefixTrie::HeapUpdate(int32_t aEntry)
+{
+  uint32_t index = mEntries[aEntry].mHeapIndex;
+  if (!SiftUp(index)) {
+    SiftDown(index);
+  }
+}
+
+bool
+nsURLPrefixTrie::SiftUp(uint32_t aIndex)
+{
+  int32_t entry = mHeap[aIndex];
+  uint32_t index = aIndex;
+  while (index > 0) {
+    uint32_t parent = (index - 1) / 2;
+    if (!IsBetter(mHeap[parent], entry)) {
+      break;
+    }
+    HeapSet(index, mHeap[parent]);
+    index = parent;
+  }
+  HeapSet(index, entry);
+  return index != aIndex;
+}
+
+void
+nsURLPrefixTrie::SiftDown(uint32_t aIndex)
+{
+  int32_t entry = mHeap[aIndex];
+  uint32_t length = mHeap.Length();
+  uint32_t index = aIndex;
+  while (2 * index + 1 < length) {
+    uint32_t child = 2 * index + 1;
+    if (child + 1 < length && IsBetter(mHeap[child], mHeap[child + 1])) {
+      child++;
+    }
+    if (!IsBetter(entry, mHeap[child])) {
+      break;
+    }
+    HeapSet(index, mHeap[child]);
+    index = child;
+  }
+  HeapSet(index, entry);
+}
+
+void
+nsURLPrefixTrie::HeapSet(uint32_t aIndex, int32_t aEntry)
+{
+  mHeap[aIndex] = aEntry;
+  mEntries[aEntry].mHeapIndex = aIndex;
+}
+
+void
+nsURLPrefixTrie::Rebuild()
+{
+  nsTArray<Entry> entries;
+  for (uint32_t i = 0; i < mEntries.Length(); ++i) {
+    if (!mEntries[i].mText.IsEmpty()) {
+      entries.AppendElement(mEntries[i]);
+    }
+  }
+
+  Clear();
+  for (uint32_t i = 0; i < entries.Length(); ++i) {
+    Add(entries[i].mText, entries[i].mFrecency, false);
+  }
+}
+
+nsresult
+nsURLPrefixTrie::ParseSnapshot(const char* aData, uint32_t aLength)
+{
+  if (aLength < kHeaderLength ||
+      memcmp(aData, kSnapshotMagic, kMagicLength) != 0) {
+    return NS_ERROR_FILE_CORRUPTED;
+  }
+
+  uint32_t count;
+  memcpy(&count, aData + kMagicLength, sizeof(count));
+
+  // Check the whole snapshot before touching the trie.
+  nsTArray<Entry> entries;
+  uint32_t offset = kHeaderLength;
+  for (uint32_t i = 0; i < count; ++i) {
+    double frecency;
+    uint32_t length;
+    if (aLength - offset < sizeof(frecency) + sizeof(length)) {
+      return NS_ERROR_FILE_CORRUPTED;
+    }
+    memcpy(&frecency, aData + offset, sizeof(frecency));
+    offset += sizeof(frecency);
+    memcpy(&length, aData + offset, sizeof(length));
+    offset += sizeof(length);
+    if (length == 0 || aLength - offset < length) {
+      return NS_ERROR_FILE_CORRUPTED;
+    }
+
+    Entry* entry = entries.AppendElement();
+    entry->mText.Assign(aData + offset, length);
+    entry->mFrecency = frecency;
+    offset += length;
+  }
+
+  Clear();
+  for (uint32_t i = 0; i < entries.Length(); ++i) {
+    Add(entries[i].mText, entries[i].mFrecency, false);
+  }
+  return NS_OK;
+}
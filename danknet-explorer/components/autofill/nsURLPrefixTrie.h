@@ -0,0 +1,76 @@
+/* -*- Mode: C++; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef nsURLPrefixTrie_h__
+#define nsURLPrefixTrie_h__
+
+#include "nsIURLPrefixTrie.h"
+#include "nsStringAPI.h"
+#include "nsTArray.h"
+#include "mozilla/Attributes.h"
+
+class nsURLPrefixTrie final : public nsIURLPrefixTrie
+{
+public:
+  NS_DECL_ISUPPORTS
+  NS_DECL_NSIURLPREFIXTRIE
+
+  nsURLPrefixTrie();
+
+protected:
+  ~nsURLPrefixTrie() {}
+
+private:
+  // Nodes are stored in mNodes, the root first.  Children of a node are
+  // linked through mNextSibling; an index of 0 means that there's none.
+  struct Node
+  {
+    uint32_t mFirstChild;
+    uint32_t mNextSibling;
+    // The entry ending at this node, or -1.
+    int32_t mEntry;
+    // The best ranked entry in the subtree of this node, or -1.
+    int32_t mBest;
+    char mChar;
+  };
+
+  struct Entry
+  {
+    nsCString mText;
+    double mFrecency;
+    uint32_t mNode;
+    // The position of the entry in mHeap.
+    uint32_t mHeapIndex;
+  };
+
+  int32_t FindNode(const nsACString& aKey, bool aCreate);
+  void UpdateBest(const nsACString& aKey);
+  bool IsBetter(int32_t aEntry, int32_t aOther) const;
+  void RemoveEntry(int32_t aEntry);
+  int32_t FindWorstEntry() const;
+  void HeapInsert(int32_t aEntry);
+  void HeapRemove(int32_t aEntry);
+  void HeapUpdate(int32_t aEntry);
+  bool SiftUp(uint32_t aIndex);
+  void SiftDown(uint32_t aIndex);
+  void HeapSet(uint32_t aIndex, int32_t aEntry);
+  void Rebuild();
+  nsresult ParseSnapshot(const char* aData, uint32_t aLength);
+
+  nsTArray<Node> mNodes;
+  // Removed entries have an empty mText, and their index in mFreeEntries.
+  nsTArray<Entry> mEntries;
+  nsTArray<int32_t> mFreeEntries;
+  // Live entries in a binary heap, the worst ranked one first, so that it can
+  // be evicted without looking at all of them.
+  nsTArray<int32_t> mHeap;
+  uint32_t mCount;
+  uint32_t mMaxEntries;
+  // Entries removed since the nodes were last rebuilt, their nodes are only
+  // reclaimed then.
+  uint32_t mRemovedCount;
+};
+
+#endif // nsURLPrefixTrie_h__
@@ -22,6 +22,13 @@
 #define NS_ABOUTFEEDS_CID \
 { 0x12ff56ec, 0x58be, 0x402c, { 0xb0, 0x57, 0x1, 0xf9, 0x61, 0xde, 0x96, 0x9b } }
 
+// a8077bc4-3404-48d6-9dd7-44e5b64e4c84
+#define NS_URLPREFIXTRIE_CID \
+{ 0xa8077bc4, 0x3404, 0x48d6, { 0x9d, 0xd7, 0x44, 0xe5, 0xb6, 0x4e, 0x4c, 0x84 } }
+
+#define NS_URLPREFIXTRIE_CONTRACTID \
+  "@mozilla.org/browser/url-prefix-trie;1"
+
 // 136e2c4d-c5a4-477c-b131-d93d7d704f64
 #define NS_PRIVATE_BROWSING_SERVICE_WRAPPER_CID \
 { 0x136e2c4d, 0xc5a4, 0x477c, { 0xb1, 0x31, 0xd9, 0x3d, 0x7d, 0x70, 0x4f, 0x64 } }
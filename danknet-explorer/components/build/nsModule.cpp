@@ -18,6 +18,7 @@
 
 #include "rdf.h"
 #include "nsFeedSniffer.h"
+#include "nsURLPrefixTrie.h"
 
 #include "nsNetCID.h"
 
@@ -35,6 +36,7 @@ NS_GENERIC_FACTORY_CONSTRUCTOR_INIT(nsGNOMEShellService, Init)
 #endif
 
 NS_GENERIC_FACTORY_CONSTRUCTOR(nsFeedSniffer)
+NS_GENERIC_FACTORY_CONSTRUCTOR(nsURLPrefixTrie)
 
 NS_DEFINE_NAMED_CID(NS_BROWSERDIRECTORYPROVIDER_CID);
 #if defined(XP_WIN)
@@ -43,6 +45,7 @@ NS_DEFINE_NAMED_CID(NS_SHELLSERVICE_CID);
 NS_DEFINE_NAMED_CID(NS_SHELLSERVICE_CID);
 #endif
 NS_DEFINE_NAMED_CID(NS_FEEDSNIFFER_CID);
+NS_DEFINE_NAMED_CID(NS_URLPREFIXTRIE_CID);
 #ifdef XP_MACOSX
 NS_DEFINE_NAMED_CID(NS_SHELLSERVICE_CID);
 #endif
@@ -55,6 +58,7 @@ static const mozilla::Module::CIDEntry kBrowserCIDs[] = {
     { &kNS_SHELLSERVICE_CID, false, nullptr, nsGNOMEShellServiceConstructor },
 #endif
     { &kNS_FEEDSNIFFER_CID, false, nullptr, nsFeedSnifferConstructor },
+    { &kNS_URLPREFIXTRIE_CID, false, nullptr, nsURLPrefixTrieConstructor },
 #ifdef XP_MACOSX
     { &kNS_SHELLSERVICE_CID, false, nullptr, nsMacShellServiceConstructor },
 #endif
@@ -69,6 +73,7 @@ static const mozilla::Module::ContractIDEntry kBrowserContracts[] = {
     { NS_SHELLSERVICE_CONTRACTID, &kNS_SHELLSERVICE_CID },
 #endif
     { NS_FEEDSNIFFER_CONTRACTID, &kNS_FEEDSNIFFER_CID },
+    { NS_URLPREFIXTRIE_CONTRACTID, &kNS_URLPREFIXTRIE_CID },
 #ifdef XP_MACOSX
     { NS_SHELLSERVICE_CONTRACTID, &kNS_SHELLSERVICE_CID },
 #endif
@@ -34,6 +34,14 @@ const nsIDM = Ci.nsIDownloadManager;
 const DESTINATION_FILE_URI_ANNO  = "downloads/destinationFileURI";
 const DOWNLOAD_META_DATA_ANNO    = "downloads/metaData";
 
+// History downloads are only given an element when they are about to be
+// scrolled into view, this many at a time.
+const HISTORY_ROWS_PER_BATCH = 100;
+
+// The next batch of history downloads is displayed when there are fewer than
+// this many elements below the visible area.
+const HISTORY_ROWS_AHEAD = 20;
+
 const DOWNLOAD_VIEW_SUPPORTED_COMMANDS =
  ["cmd_delete", "cmd_copy", "cmd_paste", "cmd_selectAll",
   "downloadsCmd_pauseResume", "downloadsCmd_cancel",
@@ -91,6 +99,7 @@ HistoryDownload.prototype = {
       // is refreshed, at which point these values may be updated.
       this.target.exists = true;
       this.target.size = metaData.fileSize;
+      this.sha256 = metaData.sha256 || null;
     } else {
       // Metadata might be missing from a download that has started but hasn't
       // stopped already. Normally, this state is overridden with the one from
@@ -109,6 +118,7 @@ HistoryDownload.prototype = {
       // These properties may be updated if the user interface is refreshed.
       this.target.exists = false;
       this.target.size = undefined;
+      this.sha256 = null;
     }
   },
 
@@ -175,9 +185,10 @@ HistoryDownload.prototype = {
  * both a history and a session download are present, the session download gets
  * priority and its information is displayed.
  *
- * On construction, a new richlistitem is created, and can be accessed through
- * the |element| getter. The shell doesn't insert the item in a richlistbox, the
- * caller must do it and remove the element when it's no longer needed.
+ * A richlistitem is created the first time the |element| getter is accessed,
+ * so that history downloads that are never displayed don't have one. The shell
+ * doesn't insert the item in a richlistbox, the caller must do it and remove
+ * the element when it's no longer needed.
  *
  * The caller is also responsible for forwarding status notifications for
  * session downloads, calling the onStateChanged and onChanged methods.
@@ -188,12 +199,6 @@ HistoryDownload.prototype = {
  *        The history download, required if aSessionDownload is not set.
  */
 function HistoryDownloadElementShell(aSessionDownload, aHistoryDownload) {
-  this.element = document.createElement("richlistitem");
-  this.element._shell = this;
-
-  this.element.classList.add("download");
-  this.element.classList.add("download-state");
-
   if (aSessionDownload) {
     this.sessionDownload = aSessionDownload;
   }
@@ -205,6 +210,71 @@ function HistoryDownloadElementShell(aSessionDownload, aHistoryDownload) {
 HistoryDownloadElementShell.prototype = {
   __proto__: DownloadsViewUI.DownloadElementShell.prototype,
 
+  get element() {
+    if (!this._element) {
+      this._ensureMetaData();
+      this._element = document.createElement("richlistitem");
+      this._element._shell = this;
+      this._element._placesNode = this._placesNode;
+
+      this._element.classList.add("download");
+      this._element.classList.add("download-state");
+    }
+    return this._element;
+  },
+  _element: null,
+
+  /**
+   * Whether the element of this shell has been created and is in a document.
+   */
+  get displayed() {
+    return !!this._element && !!this._element.parentNode;
+  },
+
+  /**
+   * Forgets the element of a shell that is no longer displayed.  A new one is
+   * created, and must be activated again, when it is displayed again.
+   */
+  releaseElement() {
+    this._element = null;
+    this.__progressElement = null;
+    this._active = false;
+  },
+
+  /**
+   * The Places node of the history download, which is also set on the element
+   * as _placesNode, or null.
+   */
+  get placesNode() {
+    return this._placesNode;
+  },
+  set placesNode(aValue) {
+    this._placesNode = aValue;
+    if (this._element) {
+      this._element._placesNode = aValue;
+    }
+    return aValue;
+  },
+  _placesNode: null,
+
+  /**
+   * Function returning the Places metadata of the history download, when it
+   * could not be taken from the cache of the view.  It's only called the first
+   * time the shell is displayed or searched.
+   */
+  readMetaData: null,
+
+  _ensureMetaData() {
+    if (this.readMetaData) {
+      let metaData = this.readMetaData(this.placesNode.uri);
+      this.readMetaData = null;
+      if (this._historyDownload) {
+        this._historyDownload.updateFromMetaData(metaData);
+        this._searchText = null;
+      }
+    }
+  },
+
   /**
    * Manages the "active" state of the shell.  By default all the shells without
    * a session download are inactive, thus their UI is not updated.  They must
@@ -241,6 +311,7 @@ HistoryDownloadElementShell.prototype = {
       }
 
       this._sessionDownload = aValue;
+      this._searchText = null;
 
       this.ensureActive();
       this._updateUI();
@@ -259,6 +330,7 @@ HistoryDownloadElementShell.prototype = {
       }
 
       this._historyDownload = aValue;
+      this._searchText = null;
 
       // We don't need to update the UI if we had a session data item, because
       // the places information isn't used in this case.
@@ -295,6 +367,7 @@ HistoryDownloadElementShell.prototype = {
   },
 
   onStateChanged() {
+    this._searchText = null;
     this.element.setAttribute("image", this.image);
     this.element.setAttribute("state",
                               DownloadsCommon.stateOfDownload(this.download));
@@ -400,10 +473,18 @@ HistoryDownloadElementShell.prototype = {
   matchesSearchTerm: function(aTerm) {
     if (!aTerm)
       return true;
+    this._ensureMetaData();
+    // Searching the whole history is frequent while typing, so the lowercase
+    // text is kept until the download changes.
+    if (this._searchText === null) {
+      this._searchText = [this.displayName.toLowerCase(),
+                          this.download.source.url.toLowerCase()];
+    }
     aTerm = aTerm.toLowerCase();
-    return this.displayName.toLowerCase().contains(aTerm) ||
-           this.download.source.url.toLowerCase().contains(aTerm);
+    return this._searchText[0].contains(aTerm) ||
+           this._searchText[1].contains(aTerm);
   },
+  _searchText: null,
 
   // Handles return keypress on the element (the keypress listener is
   // set in the DownloadsPlacesView object).
@@ -497,6 +578,10 @@ function DownloadsPlacesView(aRichListBox, aActive = true) {
   // Map download URLs to download element shells regardless of their type
   this._downloadElementsShellsForURI = new Map();
 
+  // URIs of session downloads, whose metadata was removed from the Places
+  // metadata cache and must be read again for their history downloads.
+  this._uncachedPlacesMetaData = new Set();
+
   // Map download data items to their element shells.
   this._viewItemsForDownloads = new WeakMap();
 
@@ -504,6 +589,25 @@ function DownloadsPlacesView(aRichListBox, aActive = true) {
   // in order to keep all session downloads above past downloads.
   this._lastSessionDownloadElement = null;
 
+  // Shells of the history downloads without a session download, in the order
+  // they are listed below the session downloads.  Only the ones before
+  // _historyShellsShown that match the search term are displayed, the others
+  // don't have an element until the list is scrolled close to them.  Removed
+  // shells are replaced with null until there are too many of them.
+  this._historyShells = [];
+  this._historyShellsShown = 0;
+
+  // Map the shells in _historyShells to their position, offset by
+  // _historyShellsFirstKey, which is lowered when a shell is inserted first.
+  this._historyShellKeys = new Map();
+  this._historyShellsFirstKey = 0;
+
+  // Whether all the downloads were selected by cmd_selectAll, including the
+  // history downloads that are not displayed yet, and the number of elements
+  // that were selected since then.  Selecting fewer elements clears it.
+  this._allSelected = false;
+  this._allSelectedCount = 0;
+
   this._searchTerm = "";
 
   this._active = aActive;
@@ -559,7 +663,8 @@ DownloadsPlacesView.prototype = {
    * the session, except in the case where a session download is running for the
    * same URI as a history download. To ensure we don't use stale data, URIs
    * corresponding to session downloads are permanently removed from the cache.
-   * This is a very small mumber compared to history downloads.
+   * This is a very small mumber compared to history downloads.  Since all the
+   * annotations are read, any other URI missing from the cache has no metadata.
    *
    * This property returns a Map from each download source URI found in Places
    * annotations to an object with the format:
@@ -643,15 +748,13 @@ DownloadsPlacesView.prototype = {
    *        The Places node for a history download, or null for session downloads.
    * @param [optional] aNewest
    *        @see onDownloadAdded. Ignored for history downloads.
-   * @param [optional] aDocumentFragment
-   *        To speed up the appending of multiple elements to the end of the
-   *        list which are coming in a single batch (i.e. invalidateContainer),
-   *        a document fragment may be passed to which the new elements would
-   *        be appended. It's the caller's job to ensure the fragment is merged
-   *        to the richlistbox at the end.
+   * @param [optional] aBatch
+   *        True if multiple history downloads are coming in a single batch
+   *        (i.e. invalidateContainer).  It's the caller's job to display the
+   *        first history downloads and activate the visible shells at the end.
    */
   _addDownloadData(sessionDownload, aPlacesNode, aNewest = false,
-                               aDocumentFragment = null) {
+                   aBatch = false) {
     let downloadURI = aPlacesNode ? aPlacesNode.uri
                                   : sessionDownload.source.url;
     let shellsForURI = this._downloadElementsShellsForURI.get(downloadURI);
@@ -670,6 +773,7 @@ DownloadsPlacesView.prototype = {
     // simpler solution rather than keeping a list of cache items to ignore.
     if (sessionDownload) {
       this._cachedPlacesMetaData.delete(sessionDownload.source.url);
+      this._uncachedPlacesMetaData.add(sessionDownload.source.url);
     }
 
     let newOrUpdatedShell = null;
@@ -701,6 +805,7 @@ DownloadsPlacesView.prototype = {
       for (let shell of shellsForURI) {
         if (!shell.sessionDownload) {
           shouldCreateShell = false;
+          this._removeHistoryShell(shell);
           shell.sessionDownload = sessionDownload;
           newOrUpdatedShell = shell;
           this._viewItemsForDownloads.set(sessionDownload, shell);
@@ -712,17 +817,24 @@ DownloadsPlacesView.prototype = {
     if (shouldCreateShell) {
       // If we are adding a new history download here, it means there is no
       // associated session download, thus we must read the Places metadata,
-      // because it will not be obscured by the session download.
+      // because it will not be obscured by the session download.  The few
+      // that are not in the cache are only read when the shell is displayed.
       let historyDownload = null;
+      let uncached = false;
       if (aPlacesNode) {
-        let metaData = this._cachedPlacesMetaData.get(aPlacesNode.uri) ||
-                       this._getPlacesMetaDataFor(aPlacesNode.uri);
         historyDownload = new HistoryDownload(aPlacesNode);
-        historyDownload.updateFromMetaData(metaData);
+        uncached = this._uncachedPlacesMetaData.has(aPlacesNode.uri);
+        if (!uncached) {
+          historyDownload.updateFromMetaData(
+            this._cachedPlacesMetaData.get(aPlacesNode.uri) || {});
+        }
       }
       let shell = new HistoryDownloadElementShell(sessionDownload,
                                                   historyDownload);
-      shell.element._placesNode = aPlacesNode;
+      shell.placesNode = aPlacesNode;
+      if (uncached) {
+        shell.readMetaData = this._getPlacesMetaDataFor;
+      }
       newOrUpdatedShell = shell;
       shellsForURI.add(shell);
       if (sessionDownload) {
@@ -746,7 +858,7 @@ DownloadsPlacesView.prototype = {
           // Create the element to host the metadata when needed.
           shell.historyDownload = new HistoryDownload(aPlacesNode);
         }
-        shell.element._placesNode = aPlacesNode;
+        shell.placesNode = aPlacesNode;
       }
     }
 
@@ -768,19 +880,24 @@ DownloadsPlacesView.prototype = {
         this._lastSessionDownloadElement = newOrUpdatedShell.element;
       }
       else {
-        let appendTo = aDocumentFragment || this._richlistbox;
-        appendTo.appendChild(newOrUpdatedShell.element);
+        // History downloads are displayed right away only if all the ones
+        // before them are, otherwise they will be when scrolled close to.
+        this._addHistoryShell(newOrUpdatedShell, false);
+        if (!aBatch &&
+            this._historyShellsShown == this._historyShells.length - 1) {
+          this._showMoreHistoryShells(1);
+        }
       }
 
-      if (this.searchTerm) {
+      if (this.searchTerm && sessionDownload) {
         newOrUpdatedShell.element.hidden =
-          !newOrUpdatedShell.element._shell.matchesSearchTerm(this.searchTerm);
+          !newOrUpdatedShell.matchesSearchTerm(this.searchTerm);
       }
     }
 
-    // If aDocumentFragment is defined this is a batch change, so it's up to
-    // the caller to append the fragment and activate the visible shells.
-    if (!aDocumentFragment) {
+    // If this is a batch change, it's up to the caller to display the new
+    // elements and activate the visible shells.
+    if (!aBatch) {
       this._ensureVisibleElementsAreActive();
       goUpdateCommand("downloadsCmd_clearDownloads");
     }
@@ -816,7 +933,10 @@ DownloadsPlacesView.prototype = {
           shell.historyDownload = null;
         }
         else {
-          this._removeElement(shell.element);
+          if (shell.displayed) {
+            this._removeElement(shell.element);
+          }
+          this._removeHistoryShell(shell);
           shellsForURI.delete(shell);
           if (shellsForURI.size == 0)
             this._downloadElementsShellsForURI.delete(downloadURI);
@@ -854,6 +974,7 @@ DownloadsPlacesView.prototype = {
       let url = shell.historyDownload.source.url;
       let metaData = this._getPlacesMetaDataFor(url);
       shell.historyDownload.updateFromMetaData(metaData);
+      shell.readMetaData = null;
       shell.sessionDownload = null;
       // Move it below the session-download items;
       if (this._lastSessionDownloadElement == shell.element) {
@@ -864,9 +985,122 @@ DownloadsPlacesView.prototype = {
           this._lastSessionDownloadElement.nextSibling : this._richlistbox.firstChild;
         this._richlistbox.insertBefore(shell.element, before);
       }
+      // It is now the first of the displayed history downloads.
+      this._addHistoryShell(shell, true);
+      this._historyShellsShown++;
+    }
+  },
+
+  /**
+   * Stops tracking the shell of a history download, which must be removed
+   * from the richlistbox by the caller if displayed.
+   */
+  _removeHistoryShell(aShell) {
+    let key = this._historyShellKeys.get(aShell);
+    if (key === undefined) {
+      return;
+    }
+    this._historyShells[key - this._historyShellsFirstKey] = null;
+    this._historyShellKeys.delete(aShell);
+
+    // Drop the removed shells once they are the majority.
+    if (this._historyShellKeys.size * 2 < this._historyShells.length) {
+      let shells = [];
+      let shown = 0;
+      for (let i = 0; i < this._historyShells.length; i++) {
+        let shell = this._historyShells[i];
+        if (shell) {
+          this._historyShellKeys.set(shell, shells.length);
+          shells.push(shell);
+          if (i < this._historyShellsShown) {
+            shown++;
+          }
+        }
+      }
+      this._historyShells = shells;
+      this._historyShellsShown = shown;
+      this._historyShellsFirstKey = 0;
     }
   },
 
+  /**
+   * Starts tracking the shell of a history download, after the others, or
+   * before them if aFirst is true.
+   */
+  _addHistoryShell(aShell, aFirst) {
+    if (aFirst) {
+      this._historyShells.unshift(aShell);
+      this._historyShellKeys.set(aShell, --this._historyShellsFirstKey);
+    } else {
+      this._historyShellKeys.set(aShell, this._historyShellsFirstKey +
+                                         this._historyShells.length);
+      this._historyShells.push(aShell);
+    }
+  },
+
+  /**
+   * Displays the next aCount history downloads matching the search term.
+   *
+   * @param aCount
+   *        Number of history downloads to display, if there are as many.
+   * @param [optional] aDetached
+   *        True to detach the richlistbox while the elements are appended,
+   *        which is faster but loses the scroll position.
+   */
+  _showMoreHistoryShells(aCount, aDetached = false) {
+    let fragment = document.createDocumentFragment();
+    let elements = [];
+    while (aCount > 0 &&
+           this._historyShellsShown < this._historyShells.length) {
+      let shell = this._historyShells[this._historyShellsShown++];
+      if (shell && shell.matchesSearchTerm(this.searchTerm)) {
+        fragment.appendChild(shell.element);
+        elements.push(shell.element);
+        aCount--;
+      }
+    }
+
+    if (!fragment.firstChild) {
+      return;
+    }
+    if (aDetached) {
+      this._appendDownloadsFragment(fragment);
+    } else {
+      this._richlistbox.appendChild(fragment);
+    }
+
+    // They were selected by cmd_selectAll already.
+    if (this._allSelected) {
+      let suppressOnSelect = this._richlistbox.suppressOnSelect;
+      this._richlistbox.suppressOnSelect = true;
+      try {
+        for (let element of elements) {
+          this._richlistbox.addItemToSelection(element);
+        }
+      } finally {
+        this._richlistbox.suppressOnSelect = suppressOnSelect;
+      }
+      this._allSelectedCount += elements.length;
+    }
+  },
+
+  /**
+   * Removes the elements of all the displayed history downloads, for example
+   * before displaying the ones matching a new search term.
+   */
+  _hideHistoryShells() {
+    this._allSelected = false;
+    for (let i = 0; i < this._historyShellsShown; i++) {
+      let shell = this._historyShells[i];
+      if (shell && shell.displayed) {
+        this._richlistbox.removeItemFromSelection(shell.element);
+        this._richlistbox.removeChild(shell.element);
+        shell.releaseElement();
+      }
+    }
+    this._historyShellsShown = 0;
+  },
+
   _ensureVisibleElementsAreActive:
   function() {
     if (!this.active || this._ensureVisibleTimer || !this._richlistbox.firstChild)
@@ -909,6 +1143,18 @@ DownloadsPlacesView.prototype = {
         firstVisibleNode && firstVisibleNode.previousSibling;
       if (nodeABoveVisibleArea && nodeABoveVisibleArea._shell)
         nodeABoveVisibleArea._shell.ensureActive();
+
+      // Display more history downloads when the end of the displayed ones is
+      // getting close to the visible area.
+      let node = nodeBelowVisibleArea;
+      for (let i = 0; node && i < HISTORY_ROWS_AHEAD; i++) {
+        node = node.nextSibling;
+      }
+      if (lastVisibleNode && !node &&
+          this._historyShellsShown < this._historyShells.length) {
+        this._showMoreHistoryShells(HISTORY_ROWS_PER_BATCH);
+        this._ensureVisibleElementsAreActive();
+      }
     }.bind(this), 10);
   },
 
@@ -995,38 +1241,48 @@ DownloadsPlacesView.prototype = {
     let suppressOnSelect = this._richlistbox.suppressOnSelect;
     this._richlistbox.suppressOnSelect = true;
     try {
-      // Remove the invalidated history downloads from the list and unset the
-      // places node for data downloads.
+      // Unset the places node for data downloads.
       // Loop backwards since _removeHistoryDownloadFromView may removeChild().
       for (let i = this._richlistbox.childNodes.length - 1; i >= 0; --i) {
         let element = this._richlistbox.childNodes[i];
-        if (element._placesNode) {
+        if (element._shell.sessionDownload && element._placesNode) {
           this._removeHistoryDownloadFromView(element._placesNode);
         }
       }
+
+      // Remove the invalidated history downloads from the list, including the
+      // ones that are not displayed, all at once.
+      this._hideHistoryShells();
+      for (let shell of this._historyShellKeys.keys()) {
+        let uri = shell.placesNode.uri;
+        let shellsForURI = this._downloadElementsShellsForURI.get(uri);
+        shellsForURI.delete(shell);
+        if (shellsForURI.size == 0) {
+          this._downloadElementsShellsForURI.delete(uri);
+        }
+      }
+      this._historyShells = [];
+      this._historyShellKeys.clear();
+      this._historyShellsFirstKey = 0;
     }
     finally {
       this._richlistbox.suppressOnSelect = suppressOnSelect;
     }
 
     if (aContainer.childCount > 0) {
-      let elementsToAppendFragment = document.createDocumentFragment();
       for (let i = 0; i < aContainer.childCount; i++) {
         try {
-          this._addDownloadData(null, aContainer.getChild(i), false,
-                                elementsToAppendFragment);
+          this._addDownloadData(null, aContainer.getChild(i), false, true);
         }
         catch(ex) {
           Cu.reportError(ex);
         }
       }
 
-      // _addDownloadData may not add new elements if there were already
-      // data items in place.
-      if (elementsToAppendFragment.firstChild) {
-        this._appendDownloadsFragment(elementsToAppendFragment);
-        this._ensureVisibleElementsAreActive();
-      }
+      // Only the first history downloads are displayed for now, the others
+      // will be when the list is scrolled.
+      this._showMoreHistoryShells(HISTORY_ROWS_PER_BATCH, true);
+      this._ensureVisibleElementsAreActive();
     }
 
     goUpdateDownloadCommands();
@@ -1084,9 +1340,15 @@ DownloadsPlacesView.prototype = {
   },
   set searchTerm(aValue) {
     if (this._searchTerm != aValue) {
+      this._searchTerm = aValue;
+
+      // Session downloads are few, and are only hidden.  History downloads are
+      // searched in memory, and only the first ones matching are displayed.
+      this._hideHistoryShells();
       for (let element of this._richlistbox.childNodes) {
         element.hidden = !element._shell.matchesSearchTerm(aValue);
       }
+      this._showMoreHistoryShells(HISTORY_ROWS_PER_BATCH);
       this._ensureVisibleElementsAreActive();
     }
     return this._searchTerm = aValue;
@@ -1187,6 +1449,9 @@ DownloadsPlacesView.prototype = {
     // the list (either a history download or a completed session download).
     // Because history downloads are always removable and are listed after the
     // session downloads, check from bottom to top.
+    if (this._historyShellKeys.size > 0) {
+      return true;
+    }
     for (let elt = this._richlistbox.lastChild; elt; elt = elt.previousSibling) {
       // Stopped, paused, and failed downloads with partial data are removed.
       let download = elt._shell.download;
@@ -1254,6 +1519,11 @@ DownloadsPlacesView.prototype = {
         break;
       case "cmd_selectAll":
         this._richlistbox.selectAll();
+        this._allSelected = true;
+        this._allSelectedCount = this._richlistbox.selectedItems.length;
+        break;
+      case "cmd_delete":
+        this._removeSelectedDownloads();
         break;
       case "cmd_paste":
         this._downloadURLFromClipboard();
@@ -1282,6 +1552,48 @@ DownloadsPlacesView.prototype = {
     }
   },
 
+  /**
+   * Removes the selected downloads, including the history downloads that are
+   * not displayed yet if all of them were selected, with a single history
+   * removal.
+   */
+  _removeSelectedDownloads: function() {
+    let uris = new Map();
+    let addURI = aShell => {
+      let url = aShell.download.source.url;
+      if (!uris.has(url)) {
+        uris.set(url, NetUtil.newURI(url));
+      }
+    };
+
+    for (let element of [...this._richlistbox.selectedItems]) {
+      let shell = element._shell;
+      if (shell.sessionDownload) {
+        DownloadsCommon.removeAndFinalizeDownload(shell.sessionDownload);
+      }
+      if (shell.historyDownload) {
+        addURI(shell);
+      }
+    }
+    if (this._allSelected) {
+      for (let i = this._historyShellsShown; i < this._historyShells.length;
+           i++) {
+        let shell = this._historyShells[i];
+        if (shell && shell.matchesSearchTerm(this.searchTerm)) {
+          addURI(shell);
+        }
+      }
+    }
+
+    if (uris.size > 0) {
+      let uriList = [...uris.values()];
+      PlacesUtils.history.runInBatchMode({
+        runBatched: () => PlacesUtils.bhistory.removePages(uriList,
+                                                           uriList.length)
+      }, null);
+    }
+  },
+
   onEvent: function() { },
 
   onContextMenu: function(aEvent)
@@ -1343,6 +1655,10 @@ DownloadsPlacesView.prototype = {
   },
 
   onSelect: function() {
+    if (this._allSelected &&
+        this._richlistbox.selectedItems.length < this._allSelectedCount) {
+      this._allSelected = false;
+    }
     goUpdateDownloadCommands();
 
     let selectedElements = this._richlistbox.selectedItems;
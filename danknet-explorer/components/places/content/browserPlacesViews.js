@@ -77,6 +77,7 @@ PlacesViewBase.prototype = {
       this._rootElt._built = false;
 
     this._result = val;
+    this._pendingRebuilds = null;
     if (val) {
       this._resultNode = val.root;
       this._rootElt._placesNode = this._resultNode;
@@ -104,6 +105,11 @@ PlacesViewBase.prototype = {
   _getDOMNodeForPlacesNode:
   function(aPlacesNode) {
     let node = this._domNodes.get(aPlacesNode, null);
+    if (!node && this._pendingRebuilds) {
+      // aPlacesNode may be new in a container whose rebuild was delayed.
+      this._flushPendingRebuilds();
+      node = this._domNodes.get(aPlacesNode, null);
+    }
     if (!node) {
       throw new Error("No DOM node set for aPlacesNode.\nnode.type: " +
                       aPlacesNode.type + ". node.parent: " + aPlacesNode);
@@ -245,21 +251,125 @@ PlacesViewBase.prototype = {
       return;
     }
 
-    this._cleanPopup(aPopup);
-
     let cc = resultNode.childCount;
-    if (cc > 0) {
+    if (cc > 0)
       this._setEmptyPopupStatus(aPopup, false);
 
-      for (let i = 0; i < cc; ++i) {
-        let child = resultNode.getChild(i);
-        this._insertNewItemToPopup(child, aPopup, null);
+    this._reconcileChildren(
+      resultNode, aPopup, aPopup._startMarker, aPopup._endMarker,
+      aChild => this._createMenuItemForPlacesNode(aChild));
+
+    if (cc == 0)
+      this._setEmptyPopupStatus(aPopup, true);
+    aPopup._built = true;
+  },
+
+  /**
+   * Updates the elements of the children of a container, so that they match
+   * its current children, rather than creating all of them again.  Elements
+   * are kept for the nodes that are still there, as well as for bookmarks and
+   * separators whose node has been replaced by an identical one.  Only the
+   * elements that are not in place are moved.
+   *
+   * @param aContainer
+   *        The container result node.
+   * @param aParentElt
+   *        The element holding the elements of the children.
+   * @param aStartElt
+   *        The element before the first child, or null if the first child is
+   *        the first element of aParentElt.
+   * @param aEndElt
+   *        The element after the last child, or null if the last child is the
+   *        last element of aParentElt.
+   * @param aCreateElement
+   *        Function creating the element for a new child.
+   */
+  _reconcileChildren:
+  function(aContainer, aParentElt, aStartElt, aEndElt, aCreateElement) {
+    let firstElt = aStartElt ? aStartElt.nextSibling : aParentElt.firstChild;
+
+    // Index the current elements by node, and by the item they show.
+    let eltsByNode = new Map();
+    let eltsByKey = new Map();
+    for (let elt = firstElt; elt != aEndElt; elt = elt.nextSibling) {
+      if (!elt._placesNode)
+        continue;
+      eltsByNode.set(elt._placesNode, elt);
+      let key = this._getReusableItemKey(elt._placesNode);
+      if (key && !eltsByKey.has(key))
+        eltsByKey.set(key, elt);
+    }
+
+    let elements = [];
+    let cc = aContainer.childCount;
+    for (let i = 0; i < cc; ++i) {
+      let child = aContainer.getChild(i);
+      let elt = eltsByNode.get(child);
+      if (elt) {
+        eltsByNode.delete(child);
+        elements.push(elt);
+        continue;
+      }
+
+      // The node may have been replaced by a new one for the same item.
+      let key = this._getReusableItemKey(child);
+      elt = key && eltsByKey.get(key);
+      if (elt && eltsByNode.get(elt._placesNode) == elt &&
+          this._canReuseElement(elt, child)) {
+        eltsByNode.delete(elt._placesNode);
+        this._domNodes.delete(elt._placesNode);
+        this._domNodes.set(child, elt);
+        elt._placesNode = child;
+      }
+      else {
+        elt = aCreateElement(child);
       }
+      elements.push(elt);
     }
-    else {
-      this._setEmptyPopupStatus(aPopup, true);
+
+    // Remove the elements of the nodes that are gone first, so that they are
+    // not in the way when comparing positions.
+    for (let elt of eltsByNode.values()) {
+      this._removeChild(elt);
+    }
+
+    let next = aStartElt ? aStartElt.nextSibling : aParentElt.firstChild;
+    for (let elt of elements) {
+      while (next != aEndElt && !next._placesNode) {
+        next = next.nextSibling;
+      }
+      if (elt == next)
+        next = next.nextSibling;
+      else
+        aParentElt.insertBefore(elt, next);
     }
-    aPopup._built = true;
+  },
+
+  /**
+   * Returns the key of the item shown for aPlacesNode, if its element can be
+   * kept when the node is replaced by an identical one, or null.
+   */
+  _getReusableItemKey: function(aPlacesNode) {
+    if (PlacesUtils.nodeIsSeparator(aPlacesNode) ||
+        PlacesUtils.nodeIsURI(aPlacesNode)) {
+      return aPlacesNode.itemId != -1 ? "item:" + aPlacesNode.itemId
+                                      : "uri:" + aPlacesNode.uri;
+    }
+    return null;
+  },
+
+  /**
+   * Whether the element of a node can be used for aPlacesNode as is.
+   */
+  _canReuseElement: function(aElt, aPlacesNode) {
+    let oldNode = aElt._placesNode;
+    if (oldNode.type != aPlacesNode.type)
+      return false;
+    if (PlacesUtils.nodeIsSeparator(aPlacesNode))
+      return true;
+    return oldNode.uri == aPlacesNode.uri &&
+           oldNode.title == aPlacesNode.title &&
+           oldNode.icon == aPlacesNode.icon;
   },
 
   _removeChild: function(aChild) {
@@ -547,6 +657,9 @@ PlacesViewBase.prototype = {
 
   nodeRemoved:
   function(aParentPlacesNode, aPlacesNode, aIndex) {
+    if (this._isRebuildPending(aParentPlacesNode))
+      return;
+
     let parentElt = this._getDOMNodeForPlacesNode(aParentPlacesNode);
     let elt = this._getDOMNodeForPlacesNode(aPlacesNode);
 
@@ -590,10 +703,53 @@ PlacesViewBase.prototype = {
   nodeLastModifiedChanged: function() { },
   nodeKeywordChanged: function() { },
   sortingChanged: function() { },
-  batching: function() { },
+
+  /**
+   * Containers invalidated during the current batch, which are rebuilt once
+   * at its end, or null if no batch is in progress.
+   */
+  _pendingRebuilds: null,
+
+  batching: function(aToggleMode) {
+    if (aToggleMode) {
+      this._pendingRebuilds = new Set();
+    }
+    else {
+      this._flushPendingRebuilds();
+      this._pendingRebuilds = null;
+    }
+  },
+
+  /**
+   * Whether the elements of the children of aPlacesNode will be rebuilt at the
+   * end of the current batch, so that changes to its children can be ignored.
+   */
+  _isRebuildPending: function(aPlacesNode) {
+    return !!this._pendingRebuilds && this._pendingRebuilds.has(aPlacesNode);
+  },
+
+  /**
+   * Rebuilds the containers invalidated so far during the current batch, when
+   * the element of one of their new children is needed before its end.
+   */
+  _flushPendingRebuilds: function() {
+    let pending = this._pendingRebuilds;
+    if (!pending || pending.size == 0)
+      return;
+
+    this._pendingRebuilds = new Set();
+    for (let placesNode of pending) {
+      // The container may have been replaced by a rebuild of its parent.
+      if (this._domNodes.has(placesNode))
+        this._rebuildContainer(placesNode);
+    }
+  },
 
   nodeInserted:
   function(aParentPlacesNode, aPlacesNode, aIndex) {
+    if (this._isRebuildPending(aParentPlacesNode))
+      return;
+
     let parentElt = this._getDOMNodeForPlacesNode(aParentPlacesNode);
     if (!parentElt._built)
       return;
@@ -613,6 +769,9 @@ PlacesViewBase.prototype = {
     // use this notification when the item in question is moved from one
     // folder to another.  Instead, it calls nodeRemoved and nodeInserted
     // for the two folders.  Thus, we can assume old-parent == new-parent.
+    if (this._isRebuildPending(aNewParentPlacesNode))
+      return;
+
     let elt = this._getDOMNodeForPlacesNode(aPlacesNode);
 
     // Here we need the <menu>.
@@ -698,6 +857,16 @@ PlacesViewBase.prototype = {
   },
 
   invalidateContainer: function(aPlacesNode) {
+    // Containers are invalidated repeatedly during batches, wait for the end.
+    if (this._pendingRebuilds && this._domNodes.has(aPlacesNode)) {
+      this._pendingRebuilds.add(aPlacesNode);
+      return;
+    }
+
+    this._rebuildContainer(aPlacesNode);
+  },
+
+  _rebuildContainer: function(aPlacesNode) {
     let elt = this._getDOMNodeForPlacesNode(aPlacesNode);
     elt._built = false;
 
@@ -963,14 +1132,12 @@ PlacesToolbar.prototype = {
       this._clearOverFolder();
 
     this._openedMenuButton = null;
-    while (this._rootElt.hasChildNodes()) {
-      this._rootElt.removeChild(this._rootElt.firstChild);
-    }
 
-    let cc = this._resultNode.childCount;
-    for (let i = 0; i < cc; ++i) {
-      this._insertNewItem(this._resultNode.getChild(i), null);
-    }
+    this._reconcileChildren(this._resultNode, this._rootElt, null, null,
+                            aChild => this._createItemForPlacesNode(aChild));
+
+    // Kept buttons may have moved in or out of the overflowing part.
+    this.updateChevron();
 
     if (this._chevronPopup.hasAttribute("type")) {
       // Chevron has already been initialized, but since we are forcing
@@ -982,6 +1149,15 @@ PlacesToolbar.prototype = {
 
   _insertNewItem:
   function(aChild, aBefore) {
+    let button = this._createItemForPlacesNode(aChild);
+    if (aBefore)
+      this._rootElt.insertBefore(button, aBefore);
+    else
+      this._rootElt.appendChild(button);
+  },
+
+  _createItemForPlacesNode:
+  function(aChild) {
     this._domNodes.delete(aChild);
 
     let type = aChild.type;
@@ -1035,10 +1211,7 @@ PlacesToolbar.prototype = {
     if (!this._domNodes.has(aChild))
       this._domNodes.set(aChild, button);
 
-    if (aBefore)
-      this._rootElt.insertBefore(button, aBefore);
-    else
-      this._rootElt.appendChild(button);
+    return button;
   },
 
   _updateChevronPopupNodesVisibility:
@@ -1176,6 +1349,9 @@ PlacesToolbar.prototype = {
 
   nodeInserted:
   function(aParentPlacesNode, aPlacesNode, aIndex) {
+    if (this._isRebuildPending(aParentPlacesNode))
+      return;
+
     let parentElt = this._getDOMNodeForPlacesNode(aParentPlacesNode);
     if (parentElt == this._rootElt) {
       let children = this._rootElt.childNodes;
@@ -1190,6 +1366,9 @@ PlacesToolbar.prototype = {
 
   nodeRemoved:
   function(aParentPlacesNode, aPlacesNode, aIndex) {
+    if (this._isRebuildPending(aParentPlacesNode))
+      return;
+
     let parentElt = this._getDOMNodeForPlacesNode(aParentPlacesNode);
     let elt = this._getDOMNodeForPlacesNode(aPlacesNode);
 
@@ -1210,6 +1389,9 @@ PlacesToolbar.prototype = {
   function(aPlacesNode,
                         aOldParentPlacesNode, aOldIndex,
                         aNewParentPlacesNode, aNewIndex) {
+    if (this._isRebuildPending(aNewParentPlacesNode))
+      return;
+
     let parentElt = this._getDOMNodeForPlacesNode(aNewParentPlacesNode);
     if (parentElt == this._rootElt) {
       // Container is on the toolbar.
@@ -1288,7 +1470,7 @@ PlacesToolbar.prototype = {
     }
   },
 
-  invalidateContainer: function(aPlacesNode) {
+  _rebuildContainer: function(aPlacesNode) {
     let elt = this._getDOMNodeForPlacesNode(aPlacesNode);
     if (elt == this._rootElt) {
       // Container is the toolbar itself.
@@ -1296,7 +1478,7 @@ PlacesToolbar.prototype = {
       return;
     }
 
-    PlacesViewBase.prototype.invalidateContainer.apply(this, arguments);
+    PlacesViewBase.prototype._rebuildContainer.apply(this, arguments);
   },
 
   _overFolder: { elt: null,
@@ -23,10 +23,6 @@ const RELOAD_ACTION_REMOVE = 2;
 // rows.
 const RELOAD_ACTION_MOVE = 3;
 
-// When removing a bunch of pages we split them in chunks to give some breath
-// to the main-thread.
-const REMOVE_PAGES_CHUNKLEN = 300;
-
 /**
  * Represents an insertion point within a container where we can insert
  * items.
@@ -1103,11 +1099,17 @@ PlacesController.prototype = {
    *          An array of transactions.
    * @param   [optional] removedFolders
    *          An array of folder nodes that have already been removed.
+   * @param   [optional][out] historyURIs
+   *          A Map of history pages to remove, by spec.  If it's not passed,
+   *          the pages are removed from history right away.
    */
-  _removeRange: function(range, transactions, removedFolders) {
+  _removeRange: function(range, transactions, removedFolders, historyURIs) {
     NS_ASSERT(transactions instanceof Array, "Must pass a transactions array");
     if (!removedFolders)
       removedFolders = [];
+    let removeNow = !historyURIs;
+    if (removeNow)
+      historyURIs = new Map();
 
     for (var i = 0; i < range.length; ++i) {
       var node = range[i];
@@ -1142,7 +1144,8 @@ PlacesController.prototype = {
                PlacesUtils.asQuery(node.parent).queryOptions.queryType ==
                  Ci.nsINavHistoryQueryOptions.QUERY_TYPE_HISTORY) {
         // This is a uri node inside an history query.
-        PlacesUtils.bhistory.removePage(NetUtil.newURI(node.uri));
+        if (!historyURIs.has(node.uri))
+          historyURIs.set(node.uri, NetUtil.newURI(node.uri));
         // History deletes are not undoable, so we don't have a transaction.
       }
       else if (node.itemId == -1 &&
@@ -1166,6 +1169,9 @@ PlacesController.prototype = {
         transactions.push(txn);
       }
     }
+
+    if (removeNow)
+      this._removeHistoryPages([...historyURIs.values()]);
   },
 
   /**
@@ -1177,14 +1183,19 @@ PlacesController.prototype = {
     var ranges = this._view.removableSelectionRanges;
     var transactions = [];
     var removedFolders = [];
+    let historyURIs = new Map();
 
     for (var i = 0; i < ranges.length; i++)
-      this._removeRange(ranges[i], transactions, removedFolders);
+      this._removeRange(ranges[i], transactions, removedFolders, historyURIs);
 
+    // The aggregated transaction removes all the items in a single bookmarks
+    // batch, so that views are only refreshed once.
     if (transactions.length > 0) {
       var txn = new PlacesAggregatedTransaction(txnName, transactions);
       PlacesUtils.transactionManager.doTransaction(txn);
     }
+
+    this._removeHistoryPages([...historyURIs.values()]);
   },
 
   /**
@@ -1194,38 +1205,49 @@ PlacesController.prototype = {
    */
   _removeRowsFromHistory: function() {
     let nodes = this._view.selectedNodes;
-    let URIs = [];
+    let URIs = new Map();
+    let containers = [];
     for (let i = 0; i < nodes.length; ++i) {
       let node = nodes[i];
       if (PlacesUtils.nodeIsURI(node)) {
-        let uri = NetUtil.newURI(node.uri);
         // Avoid duplicates.
-        if (URIs.indexOf(uri) < 0) {
-          URIs.push(uri);
-        }
+        if (!URIs.has(node.uri))
+          URIs.set(node.uri, NetUtil.newURI(node.uri));
       }
       else if (PlacesUtils.nodeIsQuery(node) &&
                PlacesUtils.asQuery(node).queryOptions.queryType ==
                  Ci.nsINavHistoryQueryOptions.QUERY_TYPE_HISTORY) {
-        this._removeHistoryContainer(node);
+        containers.push(node);
       }
     }
 
-    // Do removal in chunks to give some breath to main-thread.
-    function pagesChunkGenerator(aURIs) {
-      while (aURIs.length) {
-        let URIslice = aURIs.splice(0, REMOVE_PAGES_CHUNKLEN);
-        PlacesUtils.bhistory.removePages(URIslice, URIslice.length);
-        Services.tm.mainThread.dispatch(function() {
-          try {
-            gen.next();
-          } catch (ex if ex instanceof StopIteration) {}
-        }, Ci.nsIThread.DISPATCH_NORMAL);
-        yield;
+    // Remove the containers and the pages in a single history batch, so that
+    // views are only refreshed once.
+    PlacesUtils.history.runInBatchMode({
+      runBatched: () => {
+        containers.forEach(this._removeHistoryContainer, this);
+        this._removeHistoryPages([...URIs.values()]);
       }
-    }
-    let gen = pagesChunkGenerator(URIs);
-    gen.next();
+    }, null);
+  },
+
+  /**
+   * Removes a list of pages from history.
+   * @param   [in] aURIs
+   *          An array of the nsIURIs of the pages, without duplicates.
+   *
+   * @note history deletes are not undoable.
+   */
+  _removeHistoryPages: function(aURIs) {
+    if (aURIs.length == 0)
+      return;
+
+    // Remove all the pages at once in a single history batch, so that views
+    // get a single batching notification and rebuild once, rather than once
+    // per chunk across several event loop turns.
+    PlacesUtils.history.runInBatchMode({
+      runBatched: () => PlacesUtils.bhistory.removePages(aURIs, aURIs.length)
+    }, null);
   },
 
   /**
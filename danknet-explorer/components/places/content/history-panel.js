@@ -82,7 +82,16 @@ function searchHistory(aInput)
   // call load() on the tree manually
   // instead of setting the place attribute in history-panel.xul
   // otherwise, we will end up calling load() twice
-  gHistoryTree.load([query], options);
+  if (!aInput) {
+    gHistoryTree.load([query], options);
+    return;
+  }
+
+  // Look recent pages up in the search index when possible, rather than
+  // searching the whole database.
+  PlacesHistoryIndex.search(aInput, gHistoryTree, function(aQueries) {
+    gHistoryTree.load(aQueries || [query], options);
+  });
 }
 
 window.addEventListener("SidebarFocused",
@@ -768,6 +768,14 @@ var PlacesOrganizer = {
     var options = this.getCurrentOptions();
     var queries = this.getCurrentQueries();
 
+    // History searches answered by the search index list the matching pages,
+    // save the search itself instead.
+    if (PlacesSearchBox.value && PlacesSearchBox.filterCollection == "history") {
+      let query = PlacesUtils.history.getNewQuery();
+      query.searchTerms = PlacesSearchBox.value;
+      queries = [query];
+    }
+
     var placeSpec = PlacesUtils.history.queriesToQueryString(queries,
                                                              queries.length,
                                                              options);
@@ -872,7 +880,8 @@ var PlacesSearchBox = {
           options.resultType = currentOptions.RESULTS_AS_URI;
           options.queryType = Ci.nsINavHistoryQueryOptions.QUERY_TYPE_HISTORY;
           options.includeHidden = true;
-          currentView.load([query], options);
+          PlacesHistoryIndex.search(filterString, currentView, aQueries =>
+            currentView.load(aQueries || [query], options));
         }
         else {
           currentView.applyFilter(filterString, null, true);
@@ -9,12 +9,21 @@ const PTV_interfaces = [Ci.nsITreeView,
                         Ci.nsINavHistoryResultTreeViewer,
                         Ci.nsISupportsWeakReference];
 
+// Maximum number of rows in a block of the node-to-row index.  Blocks are
+// filled to half of it when the index is built or a block is split.
+const PTV_ROW_INDEX_BLOCK_SIZE = 128;
+
+// Number of formatted dates cached by each view.
+const PTV_MAX_DATE_STRINGS = 1000;
+
 function PlacesTreeView(aFlatList, aOnOpenFlatContainer, aController) {
   this._tree = null;
   this._result = null;
   this._selection = null;
   this._rootNode = null;
   this._rows = [];
+  this._rowIndex = null;
+  this._sparseContainers = new Set();
   this._flatList = aFlatList;
   this._openContainerCallback = aOnOpenFlatContainer;
   this._controller = aController;
@@ -113,6 +122,101 @@ PlacesTreeView.prototype = {
            nodeType != Ci.nsINavHistoryResultNode.RESULT_TYPE_FOLDER_SHORTCUT;
   },
 
+  /**
+   * Sparse Container: a container whose children each take exactly one row,
+   * so that, like for plain containers, its children are not set in the rows
+   * array until the tree asks for them.
+   *
+   * Unlike plain containers, sparse containers may have containers and
+   * separators as children.  That's only possible in flat lists, where
+   * containers are never expanded, and if no separator is hidden.  Once one
+   * of their children is opened anyway, all of their children are set in the
+   * rows array, and they are no longer sparse.
+   *
+   * @param aContainer
+   *        A container result node.
+   *
+   * @return true if the children of aContainer may be unset in the rows array,
+   *         false otherwise.
+   */
+  _isSparseContainer: function(aContainer) {
+    return this._sparseContainers.has(aContainer) ||
+           this._isPlainContainer(aContainer);
+  },
+
+  /**
+   * Sets all the children of a sparse container in the rows array, so that it
+   * may have children taking more than one row.
+   */
+  _materializeSparseContainer: function(aContainer) {
+    if (!this._sparseContainers.delete(aContainer))
+      return;
+
+    let firstChildRow = aContainer == this._rootNode ?
+                        0 : this._findRow(aContainer) + 1;
+    let cc = aContainer.childCount;
+    for (let i = 0; i < cc; i++) {
+      if (this._rows[firstChildRow + i] === undefined)
+        this._setRow(firstChildRow + i, aContainer.getChild(i));
+    }
+  },
+
+  /**
+   * The rows array is indexed by node, so that looking up the row of a node
+   * doesn't need to search the whole array.  Inserting or removing rows moves
+   * all the rows after them, so the index (see PlacesRowIndex) doesn't store
+   * rows, but keeps the nodes in the same order as the rows array, and
+   * computes their rows when they are looked up.  It must be told about every
+   * insertion and removal.
+   *
+   * @param aRow
+   *        The first row inserted or removed.
+   * @param aDelta
+   *        The number of rows inserted, or minus the number of rows removed.
+   */
+  _rowsSpliced: function(aRow, aDelta) {
+    if (this._rowIndex && aDelta != 0)
+      this._rowIndex.splice(aRow, aDelta);
+  },
+
+  /**
+   * Sets the node of a given row, in the rows array and in the index.
+   *
+   * @return aNode.
+   */
+  _setRow: function(aRow, aNode) {
+    this._rows[aRow] = aNode;
+    if (this._rowIndex)
+      this._rowIndex.set(aRow, aNode);
+    return aNode;
+  },
+
+  /**
+   * Looks up a node in the rows array, using the index.
+   *
+   * @return aNode's row if it's set in the rows array, -1 otherwise.
+   */
+  _findRow: function(aNode) {
+    if (!this._rowIndex)
+      this._rowIndex = new PlacesRowIndex(this._rows);
+
+    let row = this._rowIndex.get(aNode);
+    if (row == -1)
+      return -1;
+
+    // Every change of the rows array should be reflected in the index, but
+    // don't rely on it.
+    if (this._rows[row] !== aNode) {
+      row = this._rows.indexOf(aNode);
+      if (row == -1) {
+        this._rowIndex.delete(aNode);
+        return -1;
+      }
+      this._rowIndex.set(row, aNode);
+    }
+    return row;
+  },
+
   /**
    * Gets the row number for a given node.  Assumes that the given node is
    * visible (i.e. it's not an obsolete node).
@@ -146,32 +250,26 @@ PlacesTreeView.prototype = {
     // A node is removed form the view either if it has no parent or if its
     // root-ancestor is not the root node (in which case that's the node
     // for which nodeRemoved was called).
-    // Tycho: let ancestors = [x for (x of PlacesUtils.nodeAncestors(aNode))];
-    let ancestors = [];
-    for (let x of PlacesUtils.nodeAncestors(aNode)) {
-      ancestors.push(x);
+    // Also ensure that the entire chain is open, otherwise that node is
+    // invisible.
+    let rootAncestor = null;
+    let ancestorsOpen = true;
+    for (let ancestor of PlacesUtils.nodeAncestors(aNode)) {
+      rootAncestor = ancestor;
+      ancestorsOpen = ancestorsOpen && ancestor.containerOpen;
     }
 
-    if (ancestors.length == 0 ||
-        ancestors[ancestors.length - 1] != this._rootNode) {
+    if (rootAncestor != this._rootNode)
       throw new Error("Removed node passed to _getRowForNode");
-    }
 
-    // Ensure that the entire chain is open, otherwise that node is invisible.
-    for (let ancestor of ancestors) {
-      if (!ancestor.containerOpen)
-        throw new Error("Invisible node passed to _getRowForNode");
-    }
+    if (!ancestorsOpen)
+      throw new Error("Invisible node passed to _getRowForNode");
 
     // Non-plain containers are initially built with their contents.
     let parent = aNode.parent;
-    let parentIsPlain = this._isPlainContainer(parent);
-    if (!parentIsPlain) {
-      if (parent == this._rootNode)
-        return this._rows.indexOf(aNode);
-
-      return this._rows.indexOf(aNode, aParentRow);
-    }
+    let parentIsPlain = this._isSparseContainer(parent);
+    if (!parentIsPlain)
+      return this._findRow(aNode);
 
     let row = -1;
     let useNodeIndex = typeof(aNodeIndex) == "number";
@@ -184,10 +282,8 @@ PlacesTreeView.prototype = {
       // can avoid searching the rows array if the parent is a plain container.
       row = aParentRow + aNodeIndex + 1;
     } else {
-      // Look for the node in the nodes array.  Start the search at the parent
-      // row.  If the parent row isn't passed, we'll pass undefined to indexOf,
-      // which is fine.
-      row = this._rows.indexOf(aNode, aParentRow);
+      // Look for the node in the nodes array.
+      row = this._findRow(aNode);
       if (row == -1 && aForceBuild) {
         let parentRow = typeof(aParentRow) == "number" ? aParentRow
                                                        : this._getRowForNode(parent);
@@ -196,7 +292,7 @@ PlacesTreeView.prototype = {
     }
 
     if (row != -1)
-      this._rows[row] = aNode;
+      this._setRow(row, aNode);
 
     return row;
   },
@@ -216,7 +312,7 @@ PlacesTreeView.prototype = {
     if (parent == this._rootNode)
       return [this._rootNode, -1];
 
-    let parentRow = this._rows.lastIndexOf(parent, aChildRow - 1);
+    let parentRow = this._findRow(parent);
     return [parent, parentRow];
   },
 
@@ -240,17 +336,20 @@ PlacesTreeView.prototype = {
     }
 
     // If there's no container prior to the given row, it's a child of
-    // the root node (remember: all containers are listed in the rows array).
+    // the root node (remember: all containers are listed in the rows array,
+    // except for the children of sparse containers).
     if (!rowNode)
-      return this._rows[aRow] = this._rootNode.getChild(aRow);
+      return this._setRow(aRow, this._rootNode.getChild(aRow));
 
-    // Unset elements may exist only in plain containers.  Thus, if the nearest
-    // node is a container, it's the row's parent, otherwise, it's a sibling.
-    if (rowNode instanceof Ci.nsINavHistoryContainerResultNode)
-      return this._rows[aRow] = rowNode.getChild(aRow - row - 1);
+    // Unset elements may exist only in plain and sparse containers.  Thus, if
+    // the nearest node is a container, it's the row's parent, unless it's
+    // itself the child of a sparse container, otherwise, it's a sibling.
+    if (rowNode instanceof Ci.nsINavHistoryContainerResultNode &&
+        !this._sparseContainers.has(rowNode.parent))
+      return this._setRow(aRow, rowNode.getChild(aRow - row - 1));
 
     let [parent, parentRow] = this._getParentByChildRow(row);
-    return this._rows[aRow] = parent.getChild(aRow - parentRow - 1);
+    return this._setRow(aRow, parent.getChild(aRow - parentRow - 1));
   },
 
   /**
@@ -282,13 +381,23 @@ PlacesTreeView.prototype = {
     let newElements = new Array(cc);
     this._rows = this._rows.splice(0, aFirstChildRow)
                      .concat(newElements, this._rows);
+    this._rowsSpliced(aFirstChildRow, cc);
 
     if (this._isPlainContainer(aContainer))
       return cc;
 
+    // In flat lists, children are only set when the tree asks for them, unless
+    // separators are hidden.  Only folders have separators.
+    let sortingMode = this._result.sortingMode;
+    if (this._flatList &&
+        (sortingMode == Ci.nsINavHistoryQueryOptions.SORT_BY_NONE ||
+         !PlacesUtils.nodeIsFolder(aContainer))) {
+      this._sparseContainers.add(aContainer);
+      return cc;
+    }
+
     const openLiteral = PlacesUIUtils.RDF.GetResource("http://home.netscape.com/NC-rdf#open");
     const trueLiteral = PlacesUIUtils.RDF.GetLiteral("true");
-    let sortingMode = this._result.sortingMode;
 
     let rowsInserted = 0;
     for (let i = 0; i < cc; i++) {
@@ -304,11 +413,12 @@ PlacesTreeView.prototype = {
           // Notice that the rows array was initially resized to include all
           // children.
           this._rows.splice(row, 1);
+          this._rowsSpliced(row, -1);
           continue;
         }
       }
 
-      this._rows[row] = curChild;
+      this._setRow(row, curChild);
       rowsInserted++;
 
       // Recursively do containers.
@@ -339,8 +449,9 @@ PlacesTreeView.prototype = {
     let node = this._rows[aNodeRow];
 
     // If it's not listed yet, we know that it's a leaf node (instanceof also
-    // null-checks).
-    if (!(node instanceof Ci.nsINavHistoryContainerResultNode))
+    // null-checks).  The children of sparse containers take one row as well.
+    if (!(node instanceof Ci.nsINavHistoryContainerResultNode) ||
+        this._sparseContainers.has(node.parent))
       return 1;
 
     let outerLevel = node.indentLevel;
@@ -487,30 +598,63 @@ PlacesTreeView.prototype = {
       this._tree.ensureRowIsVisible(scrollToRow);
   },
 
+  /**
+   * Dates formatted by _convertPRTimeToString, by minute, which are valid as
+   * long as today starts at _todayStart.
+   */
+  _dateStrings: null,
+  _todayStart: 0,
+  _todayCheckedAt: 0,
+
   _convertPRTimeToString: function(aTime) {
     const MS_PER_MINUTE = 60000;
     const MS_PER_DAY = 86400000;
     let timeMs = aTime / 1000; // PRTime is in microseconds
 
-    // Date is calculated starting from midnight, so the modulo with a day are
-    // milliseconds from today's midnight.
-    // getTimezoneOffset corrects that based on local time, notice midnight
-    // can have a different offset during DST-change days.
-    let dateObj = new Date();
-    let now = dateObj.getTime() - dateObj.getTimezoneOffset() * MS_PER_MINUTE;
-    let midnight = now - (now % MS_PER_DAY);
-    midnight += new Date(midnight).getTimezoneOffset() * MS_PER_MINUTE;
+    // Today's midnight is computed at most once a second, that is once for all
+    // the cells painted at the same time.  The cached dates are dropped when it
+    // changes, either because the day is over or the time zone has changed.
+    let nowMs = Date.now();
+    if (!this._dateStrings || nowMs < this._todayCheckedAt ||
+        nowMs - this._todayCheckedAt >= 1000) {
+      this._todayCheckedAt = nowMs;
+
+      // Date is calculated starting from midnight, so the modulo with a day are
+      // milliseconds from today's midnight.
+      // getTimezoneOffset corrects that based on local time, notice midnight
+      // can have a different offset during DST-change days.
+      let now = nowMs - new Date(nowMs).getTimezoneOffset() * MS_PER_MINUTE;
+      let midnight = now - (now % MS_PER_DAY);
+      midnight += new Date(midnight).getTimezoneOffset() * MS_PER_MINUTE;
+
+      if (!this._dateStrings || midnight != this._todayStart) {
+        this._dateStrings = new Map();
+        this._todayStart = midnight;
+      }
+    }
+
+    // Seconds are not displayed, so all the times within a minute share the
+    // same string.
+    let minute = Math.floor(timeMs / MS_PER_MINUTE);
+    let dateString = this._dateStrings.get(minute);
+    if (dateString !== undefined)
+      return dateString;
 
-    let dateFormat = timeMs >= midnight ?
+    let dateFormat = timeMs >= this._todayStart ?
                       Ci.nsIScriptableDateFormat.dateFormatNone :
                       Ci.nsIScriptableDateFormat.dateFormatShort;
 
     let timeObj = new Date(timeMs);
-    return (this._dateService.FormatDateTime("", dateFormat,
+    dateString = this._dateService.FormatDateTime("", dateFormat,
       Ci.nsIScriptableDateFormat.timeFormatNoSeconds,
       timeObj.getFullYear(), timeObj.getMonth() + 1,
       timeObj.getDate(), timeObj.getHours(),
-      timeObj.getMinutes(), timeObj.getSeconds()));
+      timeObj.getMinutes(), timeObj.getSeconds());
+
+    if (this._dateStrings.size >= PTV_MAX_DATE_STRINGS)
+      this._dateStrings.clear();
+    this._dateStrings.set(minute, dateString);
+    return dateString;
   },
 
   COLUMN_TYPE_UNKNOWN: 0,
@@ -623,9 +767,10 @@ PlacesTreeView.prototype = {
     // Compute the new row number of the node.
     let row = -1;
     let cc = aParentNode.childCount;
-    if (aNewIndex == 0 || this._isPlainContainer(aParentNode) || cc == 0) {
+    if (aNewIndex == 0 || this._isSparseContainer(aParentNode) || cc == 0) {
       // We don't need to worry about sub hierarchies of the parent node
-      // if it's a plain container, or if the new node is its first child.
+      // if it's a plain or sparse container, or if the new node is its first
+      // child.
       if (aParentNode == this._rootNode)
         row = aNewIndex;
       else
@@ -659,6 +804,8 @@ PlacesTreeView.prototype = {
     }
 
     this._rows.splice(row, 0, aNode);
+    this._rowsSpliced(row, 1);
+    this._setRow(row, aNode);
     this._tree.rowCountChanged(row, 1);
 
     if (PlacesUtils.nodeIsContainer(aNode) &&
@@ -710,6 +857,7 @@ PlacesTreeView.prototype = {
     // Remove the node and its children, if any.
     let count = this._countVisibleRowsForNodeAtRow(oldRow);
     this._rows.splice(oldRow, count);
+    this._rowsSpliced(oldRow, -count);
     this._tree.rowCountChanged(oldRow, -count);
 
     // Redraw the parent if its twisty state has changed.
@@ -763,6 +911,7 @@ PlacesTreeView.prototype = {
 
     // Remove node and its children, if any, from the old position.
     this._rows.splice(oldRow, count);
+    this._rowsSpliced(oldRow, -count);
     this._tree.rowCountChanged(oldRow, -count);
 
     // Insert the node into the new position.
@@ -929,6 +1078,8 @@ PlacesTreeView.prototype = {
       // If the root node is now closed, the tree is empty.
       if (!this._rootNode.containerOpen) {
         this._rows = [];
+        this._rowIndex = null;
+        this._sparseContainers.clear();
         if (replaceCount)
           this._tree.rowCountChanged(startReplacement, -replaceCount);
 
@@ -936,6 +1087,9 @@ PlacesTreeView.prototype = {
       }
     }
     else {
+      // Its children may take more than one row from now on.
+      this._materializeSparseContainer(aContainer.parent);
+
       // Update the twisty state.
       let row = this._getRowForNode(aContainer);
       this._tree.invalidateRow(row);
@@ -955,7 +1109,9 @@ PlacesTreeView.prototype = {
     this.selection.selectEventsSuppressed = true;
 
     // First remove the old elements
+    this._sparseContainers.delete(aContainer);
     this._rows.splice(startReplacement, replaceCount);
+    this._rowsSpliced(startReplacement, -replaceCount);
 
     // If the container is now closed, we're done.
     if (!aContainer.containerOpen) {
@@ -1091,6 +1247,13 @@ PlacesTreeView.prototype = {
       this._rootNode.containerOpen = false;
     }
 
+    // The index shouldn't keep the nodes of the previous result alive.
+    this._rowIndex = null;
+    this._sparseContainers.clear();
+
+    // The locale may have changed since the dates were formatted.
+    this._dateStrings = null;
+
     if (val) {
       this._result = val;
       this._rootNode = this._result.root;
@@ -1231,9 +1394,10 @@ PlacesTreeView.prototype = {
   getColumnProperties: function(aColumn) { return ""; },
 
   isContainer: function(aRow) {
-    // Only leaf nodes aren't listed in the rows array.
-    let node = this._rows[aRow];
-    if (node === undefined)
+    // Only leaf nodes and the children of sparse containers aren't listed in
+    // the rows array.
+    let node = this._getNodeForRow(aRow);
+    if (!node)
       return false;
 
     if (PlacesUtils.nodeIsContainer(node)) {
@@ -1278,8 +1442,7 @@ PlacesTreeView.prototype = {
   },
 
   isSeparator: function(aRow) {
-    // All separators are listed in the rows array.
-    let node = this._rows[aRow];
+    let node = this._getNodeForRow(aRow);
     return node && PlacesUtils.nodeIsSeparator(node);
   },
 
@@ -1394,8 +1557,8 @@ PlacesTreeView.prototype = {
     }
 
     let node = this._rows[aRow];
-    if (node === undefined || this._isPlainContainer(node.parent)) {
-      // The node is a child of a plain container.
+    if (node === undefined || this._isSparseContainer(node.parent)) {
+      // The node is a child of a plain or sparse container.
       // If the next row is either unset or has the same parent,
       // it's a sibling.
       let nextNode = this._rows[aRow + 1];
@@ -1554,7 +1717,7 @@ PlacesTreeView.prototype = {
     if (!this._result)
       throw Cr.NS_ERROR_UNEXPECTED;
 
-    let node = this._rows[aRow];
+    let node = this._getNodeForRow(aRow);
     if (this._flatList && this._openContainerCallback) {
       this._openContainerCallback(node);
       return;
@@ -1714,7 +1877,7 @@ PlacesTreeView.prototype = {
     if (aColumn.index != 0)
       return false;
 
-    let node = this._rows[aRow];
+    let node = this._getNodeForRow(aRow);
     if (!node) {
       Cu.reportError("isEditable called for an unbuilt row.");
       return false;
@@ -1754,7 +1917,7 @@ PlacesTreeView.prototype = {
 
   setCellText: function(aRow, aColumn, aText) {
     // We may only get here if the cell is editable.
-    let node = this._rows[aRow];
+    let node = this._getNodeForRow(aRow);
     if (node.title != aText) {
       let txn = new PlacesEditItemTitleTransaction(node.itemId, aText);
       PlacesUtils.transactionManager.doTransaction(txn);
@@ -1780,3 +1943,219 @@ PlacesTreeView.prototype = {
   performActionOnRow: function(aAction, aRow) { },
   performActionOnCell: function(aAction, aRow, aColumn) { }
 };
+
+/**
+ * Maps the nodes of the rows array of a PlacesTreeView to their rows, while
+ * rows are inserted and removed.
+ *
+ * The rows are split in blocks of at most PTV_ROW_INDEX_BLOCK_SIZE slots, in
+ * order, each slot holding the node of its row, if it's set.  A Fenwick tree
+ * over the sizes of the blocks gives the first row of any block, so that the
+ * row of a node, the block of a row, and the update after inserting or
+ * removing rows, all take time logarithmic in the number of blocks, plus
+ * linear in the size of a block.
+ *
+ * @param aRows
+ *        The rows array to index.
+ */
+function PlacesRowIndex(aRows) {
+  // Slots ({ node, block }) by node.
+  this._slots = new Map();
+  this._blocks = [];
+  this._rowCount = aRows.length;
+
+  let slots = new Array(aRows.length);
+  for (let i = 0; i < aRows.length; i++)
+    slots[i] = aRows[i] ? this._newSlot(aRows[i], null) : null;
+  this._setBlocks(slots, 0, 0);
+}
+
+PlacesRowIndex.prototype = {
+  /**
+   * @return aNode's row, or -1 if it's not in the index.
+   */
+  get: function(aNode) {
+    let slot = this._slots.get(aNode);
+    if (!slot)
+      return -1;
+    let block = slot.block;
+    return this._getBlockStart(block.index) + block.slots.indexOf(slot);
+  },
+
+  /**
+   * Sets the node of an existing row.
+   */
+  set: function(aRow, aNode) {
+    if (aRow < 0 || aRow >= this._rowCount)
+      return;
+
+    let [block, offset] = this._findBlock(aRow);
+    let slot = block.slots[offset];
+    if (slot && slot.node === aNode)
+      return;
+    if (slot && this._slots.get(slot.node) === slot)
+      this._slots.delete(slot.node);
+
+    // A node is only in one row.
+    let oldSlot = this._slots.get(aNode);
+    if (oldSlot)
+      oldSlot.block.slots[oldSlot.block.slots.indexOf(oldSlot)] = null;
+
+    block.slots[offset] = this._newSlot(aNode, block);
+  },
+
+  delete: function(aNode) {
+    let slot = this._slots.get(aNode);
+    if (slot) {
+      slot.block.slots[slot.block.slots.indexOf(slot)] = null;
+      this._slots.delete(aNode);
+    }
+  },
+
+  /**
+   * Inserts aDelta unset rows before aRow, or removes -aDelta rows from aRow.
+   */
+  splice: function(aRow, aDelta) {
+    if (aDelta > 0)
+      this._insert(aRow, aDelta);
+    else if (aDelta < 0)
+      this._remove(aRow, -aDelta);
+  },
+
+  _insert: function(aRow, aCount) {
+    if (this._blocks.length == 0) {
+      this._blocks.push({ index: 0, slots: [] });
+      this._buildTree();
+    }
+
+    let block, offset;
+    if (aRow >= this._rowCount) {
+      block = this._blocks[this._blocks.length - 1];
+      offset = block.slots.length;
+    }
+    else {
+      [block, offset] = this._findBlock(aRow);
+    }
+
+    let slots = block.slots;
+    block.slots = slots.slice(0, offset)
+                       .concat(new Array(aCount).fill(null),
+                               slots.slice(offset));
+    this._rowCount += aCount;
+
+    if (block.slots.length <= PTV_ROW_INDEX_BLOCK_SIZE) {
+      this._addToTree(block.index, aCount);
+      return;
+    }
+
+    // Split the block in half-full blocks.
+    this._setBlocks(block.slots, block.index, 1);
+  },
+
+  _remove: function(aRow, aCount) {
+    aCount = Math.min(aCount, this._rowCount - aRow);
+    let emptied = false;
+    while (aCount > 0) {
+      let [block, offset] = this._findBlock(aRow);
+      let removed = block.slots.splice(offset, aCount);
+      for (let slot of removed) {
+        if (slot && this._slots.get(slot.node) === slot)
+          this._slots.delete(slot.node);
+      }
+      this._addToTree(block.index, -removed.length);
+      this._rowCount -= removed.length;
+      aCount -= removed.length;
+      emptied = emptied || block.slots.length == 0;
+    }
+
+    if (this._blocks.length >
+        4 * this._rowCount / PTV_ROW_INDEX_BLOCK_SIZE + 1) {
+      // Too many blocks were left almost empty, fill them again.
+      let slots = [];
+      for (let block of this._blocks)
+        slots = slots.concat(block.slots);
+      this._setBlocks(slots, 0, this._blocks.length);
+    }
+    else if (emptied) {
+      this._blocks = this._blocks.filter(aBlock => aBlock.slots.length > 0);
+      this._buildTree();
+    }
+  },
+
+  /**
+   * Replaces aCount blocks from aIndex with half-full blocks holding aSlots.
+   */
+  _setBlocks: function(aSlots, aIndex, aCount) {
+    let half = PTV_ROW_INDEX_BLOCK_SIZE / 2;
+    let blocks = [];
+    for (let i = 0; i < aSlots.length; i += half) {
+      let block = { index: 0, slots: aSlots.slice(i, i + half) };
+      for (let slot of block.slots) {
+        if (slot)
+          slot.block = block;
+      }
+      blocks.push(block);
+    }
+    this._blocks = this._blocks.slice(0, aIndex)
+                               .concat(blocks,
+                                       this._blocks.slice(aIndex + aCount));
+    this._buildTree();
+  },
+
+  _newSlot: function(aNode, aBlock) {
+    let slot = { node: aNode, block: aBlock };
+    this._slots.set(aNode, slot);
+    return slot;
+  },
+
+  /**
+   * Rebuilds the Fenwick tree after blocks were added or removed.
+   */
+  _buildTree: function() {
+    let tree = new Array(this._blocks.length + 1).fill(0);
+    for (let i = 1; i < tree.length; i++) {
+      let block = this._blocks[i - 1];
+      block.index = i - 1;
+      tree[i] += block.slots.length;
+      let parent = i + (i & -i);
+      if (parent < tree.length)
+        tree[parent] += tree[i];
+    }
+    this._tree = tree;
+  },
+
+  _addToTree: function(aIndex, aDelta) {
+    for (let i = aIndex + 1; i < this._tree.length; i += i & -i)
+      this._tree[i] += aDelta;
+  },
+
+  /**
+   * @return the first row of the block at aIndex.
+   */
+  _getBlockStart: function(aIndex) {
+    let start = 0;
+    for (let i = aIndex; i > 0; i -= i & -i)
+      start += this._tree[i];
+    return start;
+  },
+
+  /**
+   * @return [block, offset of aRow in the block], for an existing row.
+   */
+  _findBlock: function(aRow) {
+    // Find the number of blocks ending before aRow, by descending the tree.
+    let index = 0;
+    let offset = aRow;
+    let step = 1;
+    while (step * 2 < this._tree.length)
+      step *= 2;
+    for (; step > 0; step >>= 1) {
+      if (index + step < this._tree.length &&
+          this._tree[index + step] <= offset) {
+        index += step;
+        offset -= this._tree[index];
+      }
+    }
+    return [this._blocks[index], offset];
+  }
+};
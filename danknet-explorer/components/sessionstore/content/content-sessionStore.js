@@ -13,7 +13,7 @@ function debug(msg) {
 var EventListener = {
 
   DOM_EVENTS: [
-    "pageshow", "change", "input"
+    "pageshow"
   ],
 
   init: function () {
@@ -26,10 +26,6 @@ var EventListener = {
         if (event.persisted)
           sendAsyncMessage("SessionStore:pageshow");
         break;
-      case "input":
-      case "change":
-        sendAsyncMessage("SessionStore:input");
-        break;
       default:
         debug("received unknown event '" + event.type + "'");
         break;
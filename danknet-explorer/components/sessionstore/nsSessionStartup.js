@@ -18,6 +18,11 @@
  * if its value is "running", then it's assumed that the browser had previously
  * crashed, or at the very least that something bad happened, and that we should
  * restore the session.
+ * Between full writes of the session file, changes are appended to a journal
+ * (see SessionJournal.jsm). The journal is applied before looking at the
+ * session state, so that a crash is detected the same way.
+ * Closed tabs and closed windows are stored in separate sections of the file
+ * and only parsed when needed (see SessionLayout.jsm).
  *
  * Forced Restarts
  * In the event that a restart is required due to application update or extension
@@ -42,6 +47,10 @@ Cu.import("resource://gre/modules/Promise.jsm");
 
 XPCOMUtils.defineLazyModuleGetter(this, "_SessionFile",
   "resource:///modules/sessionstore/_SessionFile.jsm");
+XPCOMUtils.defineLazyModuleGetter(this, "SessionJournal",
+  "resource:///modules/sessionstore/SessionJournal.jsm");
+XPCOMUtils.defineLazyModuleGetter(this, "SessionLayout",
+  "resource:///modules/sessionstore/SessionLayout.jsm");
 
 const STATE_RUNNING_STR = "running";
 
@@ -81,8 +90,9 @@ SessionStartup.prototype = {
         Services.prefs.getIntPref("browser.startup.page") == 3) {
       this._ensureInitialized();
     } else {
-      _SessionFile.read().then(
-        this._onSessionFileRead.bind(this)
+      Promise.all([_SessionFile.read(), _SessionFile.readJournal()]).then(
+        ([aStateString, aJournalString]) =>
+          this._onSessionFileRead(aStateString, aJournalString)
       );
     }
   },
@@ -95,7 +105,40 @@ SessionStartup.prototype = {
     return string;
   },
 
-  _onSessionFileRead: function(aStateString) {
+  /**
+   * Apply the session journal to the session file it was written against.
+   * @returns the session state string including the journaled changes
+   */
+  _replayJournal: function(aStateString, aJournalString) {
+    if (!aStateString)
+      return aStateString;
+    try {
+      let state = SessionLayout.parse(aStateString);
+      if (SessionJournal.replay(state, aJournalString))
+        return SessionLayout.serialize(state);
+    }
+    catch (ex) {
+      debug("The session journal could not be replayed: " + ex);
+    }
+    return aStateString;
+  },
+
+  /**
+   * Convert a session state string to plain JSON, leaving it alone if it
+   * can't be parsed.
+   */
+  _toPlainJSON: function(aStateString) {
+    if (!aStateString)
+      return aStateString;
+    try {
+      return SessionLayout.toPlainJSON(aStateString);
+    }
+    catch (ex) {
+      return aStateString;
+    }
+  },
+
+  _onSessionFileRead: function(aStateString, aJournalString) {
     if (this._initialized) {
       // Initialization is complete, nothing else to do
       return;
@@ -103,10 +146,18 @@ SessionStartup.prototype = {
     try {
       this._initialized = true;
 
-      // Let observers modify the state before it is used
-      let supportsStateString = this._createSupportsString(aStateString);
-      Services.obs.notifyObservers(supportsStateString, "sessionstore-state-read", "");
-      aStateString = supportsStateString.data;
+      // Apply the changes made since the last full write of the session file
+      if (aJournalString)
+        aStateString = this._replayJournal(aStateString, aJournalString);
+
+      // Let observers modify the state before it is used. They expect plain
+      // JSON, so only convert it if there are any.
+      if (Services.obs.enumerateObservers("sessionstore-state-read").hasMoreElements()) {
+        let supportsStateString =
+          this._createSupportsString(this._toPlainJSON(aStateString));
+        Services.obs.notifyObservers(supportsStateString, "sessionstore-state-read", "");
+        aStateString = supportsStateString.data;
+      }
 
       // No valid session found.
       if (!aStateString) {
@@ -120,7 +171,7 @@ SessionStartup.prototype = {
         aStateString = aStateString.slice(1, -1);
       let corruptFile = false;
       try {
-        this._initialState = JSON.parse(aStateString);
+        this._initialState = SessionLayout.parse(aStateString);
       }
       catch (ex) {
         debug("The session file contained un-parse-able JSON: " + ex);
@@ -279,7 +330,8 @@ SessionStartup.prototype = {
         return;
       }
       let contents = _SessionFile.syncRead();
-      this._onSessionFileRead(contents);
+      let journal = _SessionFile.syncReadJournal();
+      this._onSessionFileRead(contents, journal);
     } catch(ex) {
       debug("ensureInitialized: could not read session " + ex + ", " + ex.stack);
       throw ex;
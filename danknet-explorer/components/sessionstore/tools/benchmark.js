@@ -0,0 +1,539 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ * You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/**
+ * Session store benchmark.
+ *
+ * Generates a synthetic session and measures how long the session store takes
+ * to serialize, write, read and parse it, and, when run inside the browser,
+ * to collect and restore it. It also measures the memory taken by the
+ * windows data the session store keeps (_windows), with and without string
+ * interning. Results are printed as JSON, so that the output of two builds
+ * can be compared.
+ *
+ * Headless (serialization and file I/O only), from the object directory:
+ *
+ *   dist/bin/run-mozilla.sh dist/bin/xpcshell -g dist/bin -a dist/bin \
+ *     <srcdir>/danknet-explorer/components/sessionstore/tools/benchmark.js \
+ *     [--windows=1] [--tabs=1000] [--history=10] [--forms=5] \
+ *     [--storage=1024] [--cookies=20] [--closed=10] [--iterations=5] \
+ *     [--output=<file>]
+ *
+ * Headless runs use a temporary profile directory.
+ *
+ * In the browser, additionally measuring _getCurrentState, _collectTabData
+ * and restoreHistoryPrecursor, from the Browser Console:
+ *
+ *   Services.scriptloader.loadSubScript("file:///<path>/benchmark.js",
+ *                                       { arguments: ["--tabs=200"] });
+ *
+ * Only do this with a throwaway profile: the synthetic session is restored
+ * into a new window, which is then closed. The session file of the running
+ * profile is left alone.
+ */
+
+(function(aArguments) {
+"use strict";
+
+const Cc = Components.classes;
+const Ci = Components.interfaces;
+const Cu = Components.utils;
+
+Cu.import("resource://gre/modules/Services.jsm");
+Cu.import("resource://gre/modules/Task.jsm");
+Cu.import("resource://gre/modules/Promise.jsm");
+
+const HEADLESS = typeof quit == "function";
+
+const DEFAULTS = {
+  windows: 1,     // open windows
+  tabs: 1000,     // tabs, spread over the open windows
+  history: 10,    // history entries per tab
+  forms: 5,       // form fields of the current entry of each tab
+  storage: 1024,  // characters of sessionStorage per tab
+  cookies: 20,    // session cookies per window
+  closed: 10,     // closed tabs per window
+  sites: 50,      // distinct sites the tabs are spread over
+  iterations: 5,
+  output: null
+};
+
+function parseArguments(aArgs) {
+  let options = {};
+  for (let key of Object.keys(DEFAULTS)) {
+    options[key] = DEFAULTS[key];
+  }
+  for (let arg of aArgs || []) {
+    let match = /^--([a-z]+)=(.*)$/.exec(arg);
+    if (!match || !(match[1] in DEFAULTS)) {
+      throw new Error("Unknown argument: " + arg);
+    }
+    options[match[1]] = typeof DEFAULTS[match[1]] == "number" ?
+                        parseInt(match[2], 10) : match[2];
+  }
+  return options;
+}
+
+const options = parseArguments(aArguments);
+
+/* ........ Synthetic sessions .............. */
+
+// Stands in for a serialized principal, which is about that long.
+const PRINCIPAL_B64 = "SmIcZAQFTCKVuxlUIqX3jnzhHhwAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA" +
+                      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA" +
+                      "AAAAAAAAAAAAAAA==";
+
+function siteFor(aIndex) {
+  return "https://site" + (aIndex % options.sites) + ".example.com";
+}
+
+function makeFormData() {
+  let formdata = { id: {}, xpath: {} };
+  for (let i = 0; i < options.forms; i++) {
+    if (i % 2) {
+      formdata.id["field" + i] = "value of field " + i;
+    } else {
+      formdata.xpath["/xhtml:html/xhtml:body/xhtml:form/xhtml:input[@name='f" +
+                     i + "']"] = "value of field " + i;
+    }
+  }
+  return formdata;
+}
+
+function makeTab(aIndex) {
+  let site = siteFor(aIndex);
+  let entries = [];
+  for (let i = 0; i < options.history; i++) {
+    let entry = {
+      url: site + "/page/" + (i % 5) + "?tab=" + (aIndex % 7),
+      title: "Page " + (i % 5) + " of site " + (aIndex % options.sites),
+      referrer: site + "/",
+      contentType: "text/html",
+      triggeringPrincipal_b64: PRINCIPAL_B64,
+      ID: aIndex * 1000 + i,
+      docshellID: aIndex,
+      docIdentifier: aIndex * 1000 + i,
+      scroll: "0," + (i * 100)
+    };
+    if (i == options.history - 1 && options.forms) {
+      entry.formdata = makeFormData();
+    }
+    entries.push(entry);
+  }
+
+  let tab = {
+    entries: entries,
+    index: entries.length,
+    hidden: false,
+    attributes: {},
+    image: site + "/favicon.ico"
+  };
+  if (options.storage) {
+    let storage = {};
+    let value = new Array(Math.ceil(options.storage / 2) + 1).join("x");
+    storage["key" + aIndex] = value;
+    storage["other"] = value;
+    tab.storage = {};
+    tab.storage[site] = storage;
+  }
+  return tab;
+}
+
+function makeState() {
+  let windows = [];
+  let tabsPerWindow = Math.ceil(options.tabs / options.windows);
+  let tabIndex = 0;
+  for (let w = 0; w < options.windows; w++) {
+    let tabs = [];
+    for (let t = 0; t < tabsPerWindow && tabIndex < options.tabs; t++) {
+      tabs.push(makeTab(tabIndex++));
+    }
+    let closedTabs = [];
+    for (let c = 0; c < options.closed; c++) {
+      closedTabs.push({ state: makeTab(c), title: "Closed " + c,
+                        image: null, pos: c, closedAt: Date.now() });
+    }
+    let cookies = [];
+    for (let c = 0; c < options.cookies; c++) {
+      cookies.push({ host: "site" + (c % options.sites) + ".example.com",
+                     value: "cookie value " + c, path: "/", name: "c" + c });
+    }
+    windows.push({ tabs: tabs, selected: 1, _closedTabs: closedTabs,
+                   cookies: cookies, width: 1024, height: 768,
+                   screenX: 0, screenY: 0, sizemode: "normal" });
+  }
+  return {
+    windows: windows,
+    selectedWindow: 1,
+    _closedWindows: [],
+    session: { state: "running", lastUpdate: Date.now(),
+               startTime: Date.now(), recentCrashes: 0 }
+  };
+}
+
+/* ........ Measurements .............. */
+
+const now = Cu.now ? () => Cu.now() : () => Date.now();
+
+function summarize(aTimes) {
+  let sorted = aTimes.slice().sort((a, b) => a - b);
+  let sum = sorted.reduce((a, b) => a + b, 0);
+  let round = aValue => Math.round(aValue * 1000) / 1000;
+  return {
+    median: round(sorted[Math.floor(sorted.length / 2)]),
+    mean: round(sum / sorted.length),
+    min: round(sorted[0]),
+    max: round(sorted[sorted.length - 1])
+  };
+}
+
+// Runs aFunction options.iterations times and returns its timings, in ms.
+function measure(aFunction) {
+  let times = [];
+  for (let i = 0; i < options.iterations; i++) {
+    let start = now();
+    aFunction(i);
+    times.push(now() - start);
+  }
+  return summarize(times);
+}
+
+// Like measure(), for functions returning promises.
+function measureAsync(aFunction) {
+  return Task.spawn(function*() {
+    let times = [];
+    for (let i = 0; i < options.iterations; i++) {
+      let start = now();
+      yield aFunction(i);
+      times.push(now() - start);
+    }
+    return summarize(times);
+  });
+}
+
+function countTabs(aState) {
+  return aState.windows.reduce((aCount, aWinData) => aCount + aWinData.tabs.length, 0);
+}
+
+let results = {};
+
+function benchmarkSerialization(aState) {
+  let {SessionLayout} =
+    Cu.import("resource:///modules/sessionstore/SessionLayout.jsm", {});
+  let {SessionJournal} =
+    Cu.import("resource:///modules/sessionstore/SessionJournal.jsm", {});
+
+  let json = JSON.stringify(aState);
+  let layout = SessionLayout.serialize(aState);
+
+  results.serialize = {
+    // plain JSON, as written before string interning and sections
+    json: { ms: measure(() => JSON.stringify(aState)), chars: json.length },
+    // what _saveStateObject writes
+    layout: { ms: measure(() => SessionLayout.serialize(aState)), chars: layout.length },
+    interningSavings: 1 - layout.length / json.length
+  };
+
+  let forced = () => {
+    let state = SessionLayout.parse(layout);
+    for (let winData of state.windows) {
+      winData._closedTabs.length;
+    }
+    state._closedWindows.length;
+  };
+  results.parse = {
+    json: { ms: measure(() => JSON.parse(json)) },
+    // closed tabs and windows are only parsed once accessed
+    layoutLazy: { ms: measure(() => SessionLayout.parse(layout)) },
+    layoutFull: { ms: measure(forced) }
+  };
+
+  // A save after a single tab changed, with the journal.
+  let state = SessionLayout.parse(layout);
+  SessionJournal.reset(state);
+  let entry = null;
+  results.journal = {
+    ms: measure(aIteration => {
+      state.session.lastUpdate++;
+      state.windows[0].tabs[0].entries[0].scroll = "0," + aIteration;
+      entry = SessionJournal.createEntry(state, Infinity);
+    })
+  };
+  results.journal.chars = entry ? entry.data.length : 0;
+  SessionJournal.clear();
+
+  return layout;
+}
+
+// The history entry values that _collectTabData and _serializeHistoryEntry
+// pass through _internString.
+const INTERNED_KEYS = ["url", "title", "referrer", "contentType",
+                       "triggeringPrincipal_b64"];
+
+// Returns a copy of aTabData as _collectTabData would build it: strings read
+// from session history are new instances, interned if aIntern is given.
+function collectTab(aTabData, aIntern) {
+  let copy = JSON.parse(JSON.stringify(aTabData));
+  // Joining characters makes a new, flat string.
+  let collect = aString => {
+    let string = aString.split("").join("");
+    return aIntern ? aIntern(string) : string;
+  };
+  let collectEntry = aEntry => {
+    for (let key of INTERNED_KEYS) {
+      if (typeof aEntry[key] == "string") {
+        aEntry[key] = collect(aEntry[key]);
+      }
+    }
+    (aEntry.children || []).forEach(collectEntry);
+  };
+  copy.entries.forEach(collectEntry);
+  if (copy.image) {
+    copy.image = collect(copy.image);
+  }
+  return copy;
+}
+
+function benchmarkMemory(aState) {
+  let {SessionStoreInternal} =
+    Cu.import("resource:///modules/sessionstore/SessionStore.jsm", {});
+  let memory = Cc["@mozilla.org/memory-reporter-manager;1"]
+                 .getService(Ci.nsIMemoryReporterManager);
+
+  // Returns the memory taken by the windows data collected from aState, in
+  // bytes (or null if it can't be measured), and how many tabs it holds.
+  let measureWindows = aIntern => {
+    let explicit = () => {
+      Cu.forceGC();
+      Cu.forceGC();
+      try {
+        return memory.explicit;
+      } catch (ex) {
+        return null;
+      }
+    };
+    let before = explicit();
+    let windows = {};
+    aState.windows.forEach((aWinData, aIndex) => {
+      windows["window" + aIndex] = {
+        tabs: aWinData.tabs.map(aTabData => collectTab(aTabData, aIntern))
+      };
+    });
+    let after = explicit();
+    // Counting the tabs afterwards keeps the data alive while it's measured.
+    let tabs = 0;
+    for (let id in windows) {
+      tabs += windows[id].tabs.length;
+    }
+    return {
+      bytes: before === null || after === null ? null : after - before,
+      tabs: tabs
+    };
+  };
+
+  // Use an intern table of our own, leaving the one of the running session
+  // store alone.
+  let internedStrings = SessionStoreInternal._internedStrings;
+  let plain, interned;
+  try {
+    plain = measureWindows(null);
+    SessionStoreInternal._internedStrings = new Map();
+    interned = measureWindows(aString => SessionStoreInternal._internString(aString));
+  } finally {
+    SessionStoreInternal._internedStrings = internedStrings;
+  }
+
+  results.memory = {
+    // the "explicit" memory reporter delta, after garbage collection
+    windows: {
+      tabs: plain.tabs,
+      plainBytes: plain.bytes,
+      internedBytes: interned.bytes,
+      interningSavings: plain.bytes && interned.bytes !== null ?
+                        1 - interned.bytes / plain.bytes : null
+    }
+  };
+}
+
+function benchmarkFiles(aData) {
+  return Task.spawn(function*() {
+    let {_SessionFile} =
+      Cu.import("resource:///modules/sessionstore/_SessionFile.jsm", {});
+    let {OS} = Cu.import("resource://gre/modules/osfile.jsm", {});
+    let {SessionLayout} =
+      Cu.import("resource:///modules/sessionstore/SessionLayout.jsm", {});
+
+    const PREF_COMPRESSION = "browser.sessionstore.compression";
+    let hadPref = Services.prefs.prefHasUserValue(PREF_COMPRESSION);
+    let oldPref = hadPref && Services.prefs.getBoolPref(PREF_COMPRESSION);
+
+    results.files = {};
+    try {
+      for (let compression of [false, true]) {
+        Services.prefs.setBoolPref(PREF_COMPRESSION, compression);
+        let name = compression ? "lz4" : "plain";
+
+        let write = yield measureAsync(() => _SessionFile.write(aData));
+        let info = yield OS.File.stat(_SessionFile.path);
+
+        let text;
+        let read = yield measureAsync(() => _SessionFile.read().then(aText => {
+          text = aText;
+        }));
+        // what nsSessionStartup does with the file at startup
+        let readAndParse = yield measureAsync(() => _SessionFile.read().then(aText => {
+          SessionLayout.parse(aText);
+        }));
+
+        results.files[name] = {
+          bytes: info.size,
+          write: write,
+          read: read,
+          readAndParse: readAndParse,
+          roundTrip: text == aData
+        };
+      }
+    } finally {
+      if (hadPref) {
+        Services.prefs.setBoolPref(PREF_COMPRESSION, oldPref);
+      } else {
+        Services.prefs.clearUserPref(PREF_COMPRESSION);
+      }
+      yield _SessionFile.wipe();
+    }
+  });
+}
+
+function benchmarkBrowser(aState) {
+  return Task.spawn(function*() {
+    let global = Cu.import("resource:///modules/sessionstore/SessionStore.jsm", {});
+    let {SessionStore, SessionStoreInternal} = global;
+
+    let win = Services.ww.openWindow(null, "chrome://browser/content/", "_blank",
+                                     "chrome,all,dialog=no", null);
+    yield new Promise(aResolve => win.addEventListener("load", aResolve, false));
+    yield new Promise(aResolve => win.setTimeout(aResolve, 0));
+
+    // Only restore a single window, the new one.
+    let windowState = { windows: [aState.windows[0]] };
+    let tabCount = windowState.windows[0].tabs.length;
+
+    let start = now();
+    let ready = new Promise(aResolve => {
+      win.addEventListener("SSWindowStateReady", function onReady() {
+        win.removeEventListener("SSWindowStateReady", onReady, false);
+        aResolve();
+      }, false);
+    });
+    SessionStore.setWindowState(win, JSON.stringify(windowState), true);
+    yield ready;
+    let restoreTime = now() - start;
+
+    results.restore = {
+      tabs: tabCount,
+      ms: restoreTime,
+      tabsPerSecond: tabCount / (restoreTime / 1000)
+    };
+
+    results.collect = {
+      getCurrentState: { ms: measure(() => SessionStoreInternal._getCurrentState(true)) },
+      collectTabData: {
+        ms: measure(() => {
+          for (let tab of win.gBrowser.tabs) {
+            SessionStoreInternal._collectTabData(tab);
+          }
+        }),
+        tabs: win.gBrowser.tabs.length
+      }
+    };
+
+    win.close();
+    yield new Promise(aResolve => Services.tm.mainThread.dispatch(aResolve,
+                                  Ci.nsIThread.DISPATCH_NORMAL));
+    if (SessionStore.getClosedWindowCount()) {
+      SessionStore.forgetClosedWindow(0);
+    }
+  });
+}
+
+// Points the profile directory to a temporary one, for headless runs.
+function useTemporaryProfile() {
+  let dir = Services.dirsvc.get("TmpD", Ci.nsIFile);
+  dir.append("sessionstore-benchmark");
+  dir.createUnique(Ci.nsIFile.DIRECTORY_TYPE, parseInt("700", 8));
+
+  let provider = {
+    getFile: function(aProperty, aPersistent) {
+      aPersistent.value = true;
+      if (aProperty == "ProfD" || aProperty == "ProfLD") {
+        return dir.clone();
+      }
+      throw Components.results.NS_ERROR_FAILURE;
+    },
+    QueryInterface: function(aIID) {
+      if (aIID.equals(Ci.nsIDirectoryServiceProvider) ||
+          aIID.equals(Ci.nsISupports)) {
+        return this;
+      }
+      throw Components.results.NS_ERROR_NO_INTERFACE;
+    }
+  };
+  Services.dirsvc.QueryInterface(Ci.nsIDirectoryService).registerProvider(provider);
+  return dir;
+}
+
+function run() {
+  return Task.spawn(function*() {
+    let profile = HEADLESS ? useTemporaryProfile() : null;
+    try {
+      let state = makeState();
+      let data = benchmarkSerialization(state);
+      benchmarkMemory(state);
+      if (HEADLESS) {
+        yield benchmarkFiles(data);
+      } else {
+        yield benchmarkBrowser(state);
+      }
+
+      let report = {
+        build: {
+          version: Services.appinfo.version,
+          buildID: Services.appinfo.appBuildID
+        },
+        options: options,
+        tabs: countTabs(state),
+        results: results
+      };
+      let output = JSON.stringify(report, null, 2);
+      if (options.output) {
+        let {OS} = Cu.import("resource://gre/modules/osfile.jsm", {});
+        yield OS.File.writeAtomic(options.output, new TextEncoder().encode(output));
+      }
+      return output;
+    } finally {
+      if (profile) {
+        profile.remove(true);
+      }
+    }
+  });
+}
+
+if (!HEADLESS) {
+  return run().then(aOutput => {
+    Services.console.logStringMessage(aOutput);
+    return aOutput;
+  }, Cu.reportError);
+}
+
+// xpcshell doesn't run an event loop on its own.
+let done = false;
+run().then(aOutput => print(aOutput), aError => {
+  print("Benchmark failed: " + aError + "\n" + (aError.stack || ""));
+}).then(() => done = true);
+let thread = Services.tm.currentThread;
+while (!done) {
+  thread.processNextEvent(true);
+}
+
+})(this.arguments);